@@ -2,7 +2,8 @@
 #define GAME_H_
 
 #include <string.h>
-#include "../lib/map.h"
+#include <stdint.h>
+#include "../lib/Map.h"
 
 
 typedef struct Game_t* Game;
@@ -17,4 +18,7 @@ int GameGetPlayer2ID(Game game);
 bool GameIsPlayerInGame(Game game, int playerID);
 int GameGetWinner(Game game);
 
+// the IDs of two players packed into one key, the same whichever of them is given first
+uint64_t GamePlayersKey(int player1ID, int player2ID);
+
 #endif
@@ -2,7 +2,7 @@
 #define PLAYERS_H_
 
 #include <string.h>
-#include "../lib/map.h"
+#include "../lib/Map.h"
 
 typedef struct Player_t* Player;
 
@@ -24,15 +24,26 @@ void PlayerRemovePlayer(Player player);
 void PlayerResetStats(Player player);
 
 
+// counts a game of the player in the tournament, adding the tournament if it is new; false if out of memory
+bool PlayerAddTournamentGame(Player player, int tournamentID);
+// forgets the tournament and the player's games in it; false if the player did not play in it
 bool PlayerRemoveTournament(Player player, int tournamentID);
-Map PlayerGetTournamentsList(Player player);
-
+// the number of games the player played in the tournament, 0 if none
+int PlayerGetTournamentGames(Player player, int tournamentID);
+int PlayerGetNumOfTournaments(Player player);
+// the index-th tournament of the player by increasing ID, 0 <= index < PlayerGetNumOfTournaments
+int PlayerGetTournamentID(Player player, int index);
+
+// counts a game the player played, its result is counted separately by PlayerAddWin/Loss/Draw
+void PlayerAddGame(Player player);
 void PlayerAddWin(Player player);
 void PlayerAddLoss(Player player);
 void PlayerAddDraw(Player player);
 void PlayerRemoveWin(Player player);
 void PlayerRemoveLoss(Player player);
 void PlayerRemoveDraw(Player player);
+// takes back games the player played and their results, as PlayerAddGame and PlayerAddWin/Loss/Draw counted them
+void PlayerRemoveResults(Player player, int games, int wins, int losses, int draws);
 void PlayerAddPlayTime(Player player, int timePlayed);
 
 
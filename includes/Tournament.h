@@ -1,33 +1,64 @@
 #ifndef TOURNAMENT_H_
 #define TOURNAMENT_H_
 
-#include "../lib/map.h"
+#include "../lib/Map.h"
 #include "Game.h"
 
 
 typedef struct Tournament_t* Tournament;
 
+/**
+ * Play time statistics of a tournament's games, kept up to date as games are added.
+ * With no games all the fields are 0. The variance of the play times is
+ * sumOfSquares / gamesCount - (totalPlayTime / gamesCount)^2.
+ */
+typedef struct tournament_stats_t {
+    int gamesCount;
+    int maxPlayTime;
+    int minPlayTime;
+    long long totalPlayTime;
+    double sumOfSquares;
+} TournamentStats;
+
 Tournament TournamentCreate(int tournamentID, int maxGamesPerPlayer, const char* tournamentLocation);
 void TournamentDestroy(void* t);
 void* TournamentCopy(void* t);
 
 bool TournamentDoesGameExistBetweenPlayers(Tournament tournament, int player1ID, int player2ID);
+bool TournamentHasPlayerReachedGamesLimit(Tournament tournament, int playerID);
 
 int TournamentGetID(Tournament tournament);
 int TournamentGetGamesLimitPerPlayer(Tournament tournament);
 const char* TournamentGetLocation(Tournament tournament);
 
-Tournament* TournamentAddGame(Tournament tournament, int player1ID, int player2ID, int winnerID, int playTime);
+// false if out of memory, then the tournament is unchanged
+bool TournamentAddGame(Tournament tournament, int player1ID, int player2ID, int winnerID, int playTime);
 void TournamentRemovePlayer(Tournament tournament, int playerID);
 
-// *** probably should be removed *** //
-Map TournamentGetGamesMap(Tournament tournament);  // map of games
-Map TournamentGetPlayersList(Tournament tournament);
+// the game-th game added to the tournament, 0 <= game < TournamentGetNumOfGames
+void TournamentGetGame(Tournament tournament, int game, int* player1ID, int* player2ID, int* winner, int* playTime);
+
+// the player's games, results and total play time in the tournament, all 0 if the player did not play in it
+void TournamentGetPlayerResults(Tournament tournament, int playerID, int* games, int* wins, int* losses, int* draws,
+                                int* playTime);
+
+// the player's games in the tournament, from the latest to the earliest: the latest one, then the one
+// before a given game of the player; -1 when there are no more. Each step is O(1).
+int TournamentGetPlayerLastGame(Tournament tournament, int playerID);
+int TournamentGetPlayerPreviousGame(Tournament tournament, int playerID, int game);
+
+// changes the result of a game and the standings of its players; false if out of memory, then nothing changed
+bool TournamentSetGameWinner(Tournament tournament, int game, int winner);
+
+// writes the IDs of the tournament's players in increasing order to playerIDs, which must have room for
+// TournamentGetNumOfPlayers of them, and returns their number
+int TournamentGetPlayers(Tournament tournament, int* playerIDs);
 
 int TournamentGetWinnerID(Tournament tournament);
 void TournamentSetWinnerID(Tournament tournament, int winnerID);
 
-bool TournamentIsTournamentClosed(Tournament tournament);
+bool TournamentHasTournamentEnded(Tournament tournament);
+// sets the winner by the rules of chessEndTournament from the standings kept while games are added
 void TournamentEndTournament(Tournament tournament);
 
 int TournamentGetTotalPlayedTime(Tournament tour);
@@ -35,7 +66,10 @@ int TournamentGetTotalPlayedTime(Tournament tour);
 void TournamentSetNumOfGames(Tournament tour);
 int TournamentGetNumOfGames(Tournament tour);
 
-void TournamentSetMaxPlayingTime(Tournament tour, int maxPlayingTime);
-int TournamentGetPlayingMaxTime(Tournament tour);
+int TournamentGetMaxPlayingTime(Tournament tour);
+TournamentStats TournamentGetStats(Tournament tour);
+
+// the number of players who played in the tournament, players removed later included; O(1)
+int TournamentGetNumOfPlayers(Tournament tour);
 
 #endif
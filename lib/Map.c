@@ -6,87 +6,370 @@
 //
 
 #include "Map.h"
+#include "Pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 
+/** Note:
+ * The map is kept as a B-tree. Every node holds between MIN_ELEMENTS and MAX_ELEMENTS sorted
+ * (key, data) pairs (only the root may hold less), and all leaves are at the same depth, so
+ * lookups, insertions and removals cost O(log n) compareKeys calls while the in-order walk used
+ * by the iterator still yields the keys from smallest to largest.
+ * Keys of a node are stored contiguously, so a binary search inside a node stays in a few cache lines.
+ */
+#define MIN_DEGREE 8
+#define MAX_ELEMENTS (2 * MIN_DEGREE - 1)
+#define MIN_ELEMENTS (MIN_DEGREE - 1)
 
 typedef struct node_t {
-    MapDataElement data;
-    MapKeyElement key;
-    struct node_t *next;
+    int refs;
+    int size;
+    bool isLeaf;
+    // one spare slot: a node may overflow by one element right before it is split
+    MapKeyElement keys[MAX_ELEMENTS + 1];
+    MapDataElement data[MAX_ELEMENTS + 1];
+    struct node_t *children[MAX_ELEMENTS + 2];
 } *Node;
 
+/**
+ * A position inside the tree. For every level above the deepest one, indices[level] is the child
+ * that was descended into; at the deepest level it is the element itself.
+ * depth is -1 when the path points past the last element.
+ */
+typedef MapPath Path;
+
+/**
+ * A slot of the optional hash index. The index refers to the same key and data elements the tree
+ * holds, it never owns them. An empty slot has a NULL key.
+ */
+typedef struct index_slot_t {
+    MapKeyElement key;
+    MapDataElement data;
+    unsigned int hash;
+} IndexSlot;
+
+typedef struct index_t {
+    int refs;
+    int capacity;
+    IndexSlot slots[];
+} *Index;
+
+/**
+ * A frozen map, see mapFreeze, keeps its keys in one array in Eytzinger order: slot 1 is the median and
+ * slot i has the children 2i and 2i+1, so a search walks down a binary tree stored breadth first. The top
+ * levels the searches share sit in the first cache lines of the array, and the 16 descendants four levels
+ * below a slot are contiguous, so they can be fetched while the levels above them are compared.
+ * The data of slot i is data[i] of a second array, which a search touches only once it found its key.
+ * Like the index, the slots refer to the elements of the tree, which still owns them.
+ */
+typedef struct frozen_t {
+    MapKeyElement* keys;
+    MapDataElement* data;
+} *Frozen;
+
+#define INITIAL_INDEX_CAPACITY 16
+
+/** Note on copies:
+ * mapCopy copies nothing. The copy points at the same root, and every node (and the hash index)
+ * counts the parents and maps pointing at it. A shared node is never changed: before an operation
+ * modifies it, or hands out data stored in it that the caller may modify in place, the node is cloned
+ * and the clone replaces it in this map only. A clone gets copies of the node's own elements and
+ * shares its children, so a change copies just the nodes on the path it touches.
+ * Maps made from each other by mapCopy share a lineage counter; while a map is alone in its lineage
+ * none of its nodes can be shared and all of the above is skipped.
+ * Cloning moves elements, so every cloning bumps the map's version, which tells cursors to find
+ * their key again.
+ */
 struct Map_t
 {
-    Node head;
-    Node tail;
-    Node iterator;
+    Node root;
+    MapCursor iterator;
     int size;
+    unsigned int version;
+    int* lineage;
+    Index index;
+    Frozen frozen;
+    MapStats* stats;
     copyMapDataElements copyData;
     copyMapKeyElements copyKey;
     freeMapDataElements freeData;
     freeMapKeyElements freeKey;
     compareMapKeyElements compareKeys;
+    hashMapKeyElements hashKey;
 };
 
 
-static Node NodeCreate(Map map, MapKeyElement keyElement, MapDataElement dataElement);
-static Node NodeCopy(Map map, Node node);
-static void NodeDestroy(Node node, Map map);
+/**
+ * Nodes and map headers are taken from pools shared by all the maps instead of one malloc each,
+ * so building a map costs a malloc per slab of nodes and freed nodes are reused by the next insertion.
+ */
+#define NODES_PER_SLAB 64
+#define MAPS_PER_SLAB 32
+
+static Pool nodePool = POOL_INITIALIZER(struct node_t, NODES_PER_SLAB);
+static Pool mapPool = POOL_INITIALIZER(struct Map_t, MAPS_PER_SLAB);
+
+/**
+ * Statistics are opt-in per map: stats is NULL until mapSetStatsEnabled is called, and every counter
+ * update is a single test of it.
+ */
+#define STATS_ADD(map, counter, amount) \
+    do { if((map)->stats != NULL) (map)->stats->counter += (amount); } while(0)
+
+static void statsUpdatePeak(Map map)
+{
+    if(map->stats != NULL && map->size > map->stats->peakSize)
+        map->stats->peakSize = map->size;
+}
+
+static int compareElements(Map map, MapKeyElement first, MapKeyElement second)
+{
+    STATS_ADD(map, compareCalls, 1);
+    return map->compareKeys(first, second);
+}
+
+static MapKeyElement copyKeyElement(Map map, MapKeyElement key)
+{
+    STATS_ADD(map, elementCopies, 1);
+    return map->copyKey(key);
+}
+
+static MapDataElement copyDataElement(Map map, MapDataElement data)
+{
+    STATS_ADD(map, elementCopies, 1);
+    return map->copyData(data);
+}
+
+// every change of the tree drops the frozen layout, after it the map works as an ordinary one
+static void mapThaw(Map map)
+{
+    if(map->frozen == NULL)
+        return;
+    free(map->frozen->keys);
+    free(map->frozen->data);
+    free(map->frozen);
+    map->frozen = NULL;
+}
+
+static Node NodeCreate(bool isLeaf);
+static Node NodeClone(Map map, Node node);
+static void NodeRelease(Node node, Map map);
+static void NodeFree(Node node);
 
-static Node NodeCreate(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+static Node NodeCreate(bool isLeaf)
 {
-    Node newNode = malloc(sizeof(*newNode));
+    Node newNode = poolAlloc(&nodePool);
     if(newNode == NULL)
         return NULL;
 
-    newNode->key = map->copyKey(keyElement);
-    if(newNode->key == NULL)
-    {
-        free(newNode);
+    newNode->refs = 1;
+    newNode->size = 0;
+    newNode->isLeaf = isLeaf;
+    newNode->children[0] = NULL;
+    return newNode;
+}
+
+// copies the elements of node and shares its children with it
+static Node NodeClone(Map map, Node node)
+{
+    Node newNode = NodeCreate(true);
+    if(newNode == NULL)
         return NULL;
+    STATS_ADD(map, allocations, 1);
+
+    // the clone stays a leaf until it has all its elements, so NodeRelease can free it on failure
+    for(int i = 0; i < node->size; i++, newNode->size++)
+    {
+        newNode->keys[i] = copyKeyElement(map, node->keys[i]);
+        if(newNode->keys[i] == NULL)
+        {
+            NodeRelease(newNode, map);
+            return NULL;
+        }
+        newNode->data[i] = copyDataElement(map, node->data[i]);
+        if(newNode->data[i] == NULL)
+        {
+            map->freeKey(newNode->keys[i]);
+            NodeRelease(newNode, map);
+            return NULL;
+        }
+    }
+    newNode->isLeaf = node->isLeaf;
+    if(!node->isLeaf)
+    {
+        memcpy(newNode->children, node->children, (node->size + 1) * sizeof(*node->children));
+        for(int i = 0; i <= node->size; i++)
+            node->children[i]->refs++;
     }
+    return newNode;
+}
+
+// drops one reference to node, the last one frees it with its elements and releases its children
+static void NodeRelease(Node node, Map map)
+{
+    if(node == NULL || --node->refs > 0)
+        return;
 
-    newNode->data = map->copyData(dataElement);
-    if(newNode->data == NULL)
+    for(int i = 0; i < node->size; i++)
     {
-        map->freeKey(newNode->key);
-        free(newNode);
-        return NULL;
+        map->freeData(node->data[i]);
+        map->freeKey(node->keys[i]);
+    }
+    if(!node->isLeaf)
+    {
+        for(int i = 0; i <= node->size; i++)
+            NodeRelease(node->children[i], map);
     }
+    NodeFree(node);
+}
 
-    newNode -> next = NULL;
-    return newNode;
+// releases the node itself, its elements and children must have been moved or freed already
+static void NodeFree(Node node)
+{
+    poolFree(&nodePool, node);
 }
 
-static Node NodeCopy(Map map, Node node)
+
+// spreads the user's hash over all the bits, IDs that differ only in their high bits would collide otherwise
+static unsigned int mixHash(unsigned int hash)
 {
-    Node newNode = NodeCreate(map, node->key, node->data);
-    if(newNode == NULL)
-        return NULL;
-    return  newNode;
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static int indexFind(Map map, MapKeyElement element, unsigned int hash)
+{
+    if(map->index == NULL)
+        return -1;
+    STATS_ADD(map, indexLookups, 1);
+    IndexSlot* slots = map->index->slots;
+    int mask = map->index->capacity - 1;
+    for(int i = hash & mask; slots[i].key != NULL; i = (i + 1) & mask)
+    {
+        STATS_ADD(map, indexProbes, 1);
+        if(slots[i].hash == hash && compareElements(map, slots[i].key, element) == 0)
+            return i;
+    }
+    return -1;
 }
 
-static void NodeDestroy(Node node, Map map)
+static int indexFindKey(Map map, MapKeyElement element)
 {
-    map->freeData(node->data);
-    map->freeKey(node->key);
-    free(node);
+    return indexFind(map, element, mixHash(map->hashKey(element)));
 }
 
-static void deleteNodesList(Map map)
+// the caller makes sure there is a free slot and that the key is not indexed yet
+static void indexInsert(Map map, MapKeyElement key, MapDataElement data, unsigned int hash)
 {
-    while(map->head != NULL)
+    IndexSlot* slots = map->index->slots;
+    int mask = map->index->capacity - 1;
+    int i = hash & mask;
+    while(slots[i].key != NULL)
+        i = (i + 1) & mask;
+    slots[i].key = key;
+    slots[i].data = data;
+    slots[i].hash = hash;
+}
+
+// backward shift deletion: slots after the removed one are moved up so no probe chain is broken
+static void indexRemove(Map map, int removed)
+{
+    IndexSlot* slots = map->index->slots;
+    int mask = map->index->capacity - 1;
+    int hole = removed;
+    for(int i = (hole + 1) & mask; slots[i].key != NULL; i = (i + 1) & mask)
+    {
+        int home = slots[i].hash & mask;
+        bool canMove = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if(canMove)
+        {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole].key = NULL;
+}
+
+static void indexRelease(Index index)
+{
+    if(index != NULL && --index->refs == 0)
+        free(index);
+}
+
+/**
+ * Makes the index writable by this map alone, cloning it if it is shared with a copy, and grows it
+ * so extra more elements keep the load factor at most one half.
+ */
+static MapResult indexPrepare(Map map, int extra)
+{
+    if(map->hashKey == NULL)
+        return MAP_SUCCESS;
+    int capacity = map->index == NULL ? 0 : map->index->capacity;
+    bool grow = 2 * (map->size + extra) > capacity;
+    if(!grow && (map->index == NULL || map->index->refs == 1))
+        return MAP_SUCCESS;
+
+    int newCapacity = capacity == 0 ? INITIAL_INDEX_CAPACITY : capacity;
+    while(2 * (map->size + extra) > newCapacity)
+        newCapacity *= 2;
+    Index newIndex = calloc(1, sizeof(*newIndex) + newCapacity * sizeof(*newIndex->slots));
+    if(newIndex == NULL)
+        return MAP_OUT_OF_MEMORY;
+    STATS_ADD(map, allocations, 1);
+    newIndex->refs = 1;
+    newIndex->capacity = newCapacity;
+
+    Index oldIndex = map->index;
+    map->index = newIndex;
+    for(int i = 0; i < capacity; i++)
     {
-        Node toDelete = map->head;
-        map->head = map->head->next;
-        NodeDestroy(toDelete, map);
+        IndexSlot* slot = oldIndex->slots + i;
+        if(slot->key != NULL)
+            indexInsert(map, slot->key, slot->data, slot->hash);
     }
+    indexRelease(oldIndex);
+    return MAP_SUCCESS;
 }
 
+static bool isShared(Map map)
+{
+    return map->lineage != NULL && *map->lineage > 1;
+}
+
+/**
+ * Makes the node *link points at private to this map, cloning it if it is shared, and returns it.
+ * The index must have been made private already. Returns NULL if the clone could not be allocated.
+ */
+static Node privateNode(Map map, Node* link)
+{
+    Node node = *link;
+    if(node->refs == 1)
+        return node;
+
+    Node clone = NodeClone(map, node);
+    if(clone == NULL)
+        return NULL;
+    if(map->hashKey != NULL)
+    {
+        for(int i = 0; i < node->size; i++)
+        {
+            IndexSlot* slot = map->index->slots + indexFindKey(map, node->keys[i]);
+            slot->key = clone->keys[i];
+            slot->data = clone->data[i];
+        }
+    }
+    node->refs--;
+    *link = clone;
+    map->version++;
+    mapThaw(map);
+    return clone;
+}
 
 Map mapCreate(copyMapDataElements copyDataElement, copyMapKeyElements copyKeyElement, freeMapDataElements freeDataElement,
               freeMapKeyElements freeKeyElement, compareMapKeyElements compareKeyElements)
@@ -94,15 +377,20 @@ Map mapCreate(copyMapDataElements copyDataElement, copyMapKeyElements copyKeyEle
     if(!copyDataElement || !copyKeyElement || !freeDataElement || !freeKeyElement || !compareKeyElements)
         return NULL;
 
-    Map map = malloc(sizeof(*map));
+    Map map = poolAlloc(&mapPool);
     if(map == NULL)
         return NULL;
 
     // properties initialization
-    map->head = NULL;
-    map->tail = NULL;
-    map->iterator = NULL;
+    map->root = NULL;
+    map->iterator.map = NULL;
     map->size = 0;
+    map->version = 0;
+    map->lineage = NULL;
+    map->index = NULL;
+    map->frozen = NULL;
+    map->stats = NULL;
+    map->hashKey = NULL;
 
     // utils initialization
     map->copyKey = copyKeyElement;
@@ -114,6 +402,21 @@ Map mapCreate(copyMapDataElements copyDataElement, copyMapKeyElements copyKeyEle
     return map;
 }
 
+Map mapCreateHashed(copyMapDataElements copyDataElement, copyMapKeyElements copyKeyElement,
+                    freeMapDataElements freeDataElement, freeMapKeyElements freeKeyElement,
+                    compareMapKeyElements compareKeyElements, hashMapKeyElements hashKeyElement)
+{
+    if(!hashKeyElement)
+        return NULL;
+
+    Map map = mapCreate(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement, compareKeyElements);
+    if(map == NULL)
+        return NULL;
+
+    map->hashKey = hashKeyElement;
+    return map;
+}
+
 Map mapCopy(Map map)
 {
     if(map == NULL)
@@ -124,173 +427,1702 @@ Map mapCopy(Map map)
     if(newMap == NULL)
         return NULL;
 
-    for(Node iter = map->head; iter != NULL; iter= iter->next)
+    if(map->lineage == NULL)
     {
-        if(mapPut(newMap, iter->key, iter->data) != MAP_SUCCESS)
+        map->lineage = malloc(sizeof(*map->lineage));
+        if(map->lineage == NULL)
         {
             mapDestroy(newMap);
             return NULL;
         }
+        *map->lineage = 1;
     }
+    (*map->lineage)++;
+    newMap->lineage = map->lineage;
+
+    newMap->root = map->root;
+    if(newMap->root != NULL)
+        newMap->root->refs++;
+    newMap->index = map->index;
+    if(newMap->index != NULL)
+        newMap->index->refs++;
+    newMap->hashKey = map->hashKey;
+    newMap->size = map->size;
+    // the nodes entries of map found are shared now, so they must be found again before changing them
+    map->version++;
     return newMap;
 }
 
-static Node findElement(Map map, MapKeyElement element)
+// returns the first index in node whose key is not smaller than element
+static int searchNode(Map map, Node node, MapKeyElement element, bool* found)
 {
-    for(Node iter = map->head; iter != NULL; iter= iter->next)
-        if(map->compareKeys(iter->key, element) == 0)
-            return iter;
-    return NULL;
+    STATS_ADD(map, nodesVisited, 1);
+    int low = 0, high = node->size;
+    while(low < high)
+    {
+        int middle = (low + high) / 2;
+        int result = compareElements(map, node->keys[middle], element);
+        if(result == 0)
+        {
+            *found = true;
+            return middle;
+        }
+        if(result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    *found = false;
+    return low;
 }
 
-static void removeExistingNode(Map map, Node toRemove)
+/**
+ * Descends from the root towards element and records the path in path.
+ * If element was found, the deepest level of the path points at it,
+ * otherwise the path ends in the leaf slot where element should be inserted.
+ */
+static bool findPath(Map map, MapKeyElement element, Path* path)
 {
-    if(map->head == toRemove)
+    STATS_ADD(map, searches, 1);
+    path->depth = -1;
+    Node node = map->root;
+    while(node != NULL)
     {
-        map->head = (map->head != map->tail) ? map->head->next : NULL;
-        map->tail = (map->head != map->tail) ? map->tail : NULL;
-        NodeDestroy(toRemove, map);
-        return;
+        bool found;
+        int index = searchNode(map, node, element, &found);
+        path->depth++;
+        assert(path->depth < MAP_MAX_DEPTH);
+        path->nodes[path->depth] = node;
+        path->indices[path->depth] = index;
+        if(found)
+            return true;
+        node = node->isLeaf ? NULL : node->children[index];
     }
+    return false;
+}
 
-    Node prev = map->head;
-    for(Node curr = map->head->next; curr != NULL; prev = curr, curr = curr->next)
+static Node findNode(Map map, MapKeyElement element, int* index)
+{
+    STATS_ADD(map, searches, 1);
+    Node node = map->root;
+    while(node != NULL)
     {
-        if(map->compareKeys(curr->key, toRemove->key) != 0)
-            continue;
+        bool found;
+        *index = searchNode(map, node, element, &found);
+        if(found)
+            return node;
+        node = node->isLeaf ? NULL : node->children[*index];
+    }
+    return NULL;
+}
 
-        prev->next = curr->next;
-        if(curr == map->tail)
-            map->tail = prev;
+/**
+ * Same as findPath, but every node on the path is made private to map first, so the path can be
+ * modified or its data handed out. found is set as findPath would return it.
+ * On failure the nodes that were cloned already stay in place, the map's contents are unchanged.
+ */
+static MapResult findPrivatePath(Map map, MapKeyElement element, Path* path, bool* found)
+{
+    STATS_ADD(map, searches, 1);
+    path->depth = -1;
+    *found = false;
+    if(isShared(map) && indexPrepare(map, 0) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
 
-        NodeDestroy(toRemove, map);
-        return;
+    Node* link = &map->root;
+    while(*link != NULL)
+    {
+        Node node = privateNode(map, link);
+        if(node == NULL)
+            return MAP_OUT_OF_MEMORY;
+        int index = searchNode(map, node, element, found);
+        path->depth++;
+        assert(path->depth < MAP_MAX_DEPTH);
+        path->nodes[path->depth] = node;
+        path->indices[path->depth] = index;
+        if(*found || node->isLeaf)
+            return MAP_SUCCESS;
+        link = &node->children[index];
     }
+    return MAP_SUCCESS;
 }
 
-//mapRemove: Removes a pair of key and data elements from the map.
-MapResult mapRemove(Map map, MapKeyElement keyElement)
+static void pathFirst(Map map, Path* path);
+static void pathNext(Path* path);
+static MapKeyElement pathKey(Path* path);
+static MapDataElement pathData(Path* path);
+
+/**
+ * Points path at the smallest element not smaller than element, past the end if there is none.
+ * Returns whether that element is equal to element.
+ */
+static bool pathSeek(Map map, MapKeyElement element, Path* path)
 {
-    if(map == NULL || keyElement == NULL)
+    if(findPath(map, element, path))
+        return true;
+    if(path->depth < 0)
+        return false;
+    // the leaf slot where element belongs, if it is past the leaf's end the successor is an ancestor
+    if(path->indices[path->depth] < path->nodes[path->depth]->size)
+        return false;
+    while(--path->depth >= 0)
     {
-        return MAP_NULL_ARGUMENT;
+        if(path->indices[path->depth] < path->nodes[path->depth]->size)
+            return false;
     }
-    Node toRemove = findElement(map, keyElement);
-    if(toRemove == NULL)
-        return MAP_ITEM_DOES_NOT_EXIST;
+    return false;
+}
 
-    removeExistingNode(map, toRemove);
-    map->size -= 1;
-    return MAP_SUCCESS;
+static void insertIntoNode(Node node, int index, MapKeyElement key, MapDataElement data, Node rightChild)
+{
+    int toMove = node->size - index;
+    memmove(node->keys + index + 1, node->keys + index, toMove * sizeof(*node->keys));
+    memmove(node->data + index + 1, node->data + index, toMove * sizeof(*node->data));
+    node->keys[index] = key;
+    node->data[index] = data;
+    if(!node->isLeaf)
+    {
+        memmove(node->children + index + 2, node->children + index + 1, toMove * sizeof(*node->children));
+        node->children[index + 1] = rightChild;
+    }
+    node->size++;
+}
+
+static void removeFromNode(Node node, int index)
+{
+    int toMove = node->size - index - 1;
+    memmove(node->keys + index, node->keys + index + 1, toMove * sizeof(*node->keys));
+    memmove(node->data + index, node->data + index + 1, toMove * sizeof(*node->data));
+    if(!node->isLeaf)
+        memmove(node->children + index + 1, node->children + index + 2, toMove * sizeof(*node->children));
+    node->size--;
 }
 
-static void addNonExistingNode(Map map, Node node)
+// moves the upper half of an overflowing node into right, the median stays at node->keys[MIN_DEGREE]
+static void splitNode(Node node, Node right)
 {
-    if(mapGetSize(map) == 0)
+    int toMove = node->size - MIN_DEGREE - 1;
+    memcpy(right->keys, node->keys + MIN_DEGREE + 1, toMove * sizeof(*node->keys));
+    memcpy(right->data, node->data + MIN_DEGREE + 1, toMove * sizeof(*node->data));
+    if(!node->isLeaf)
+        memcpy(right->children, node->children + MIN_DEGREE + 1, (toMove + 1) * sizeof(*node->children));
+    right->size = toMove;
+    node->size = MIN_DEGREE;
+}
+
+/**
+ * Inserts an already copied (key, data) pair at the leaf slot recorded in path, splitting
+ * every node on the way up that overflows. All the nodes that might be needed are allocated
+ * before the tree is touched, so running out of memory leaves the map unchanged.
+ */
+static MapResult insertAtPath(Map map, Path* path, MapKeyElement key, MapDataElement data)
+{
+    if(map->root == NULL)
     {
-        map->head = node;
-        map->tail = node;
-        return;
+        map->root = NodeCreate(true);
+        if(map->root == NULL)
+            return MAP_OUT_OF_MEMORY;
+        STATS_ADD(map, allocations, 1);
+        insertIntoNode(map->root, 0, key, data, NULL);
+        map->version++;
+        mapThaw(map);
+        return MAP_SUCCESS;
     }
 
-    Node prev = NULL;
-    for(Node curr = map->head; curr != NULL; prev = curr, curr = curr->next)
+    Node spares[MAP_MAX_DEPTH + 1];
+    int needed = 0;
+    for(int level = path->depth; level >= 0 && path->nodes[level]->size == MAX_ELEMENTS; level--)
+        needed++;
+    needed += (needed == path->depth + 1); // the root splits as well, a new root is needed
+    for(int i = 0; i < needed; i++)
     {
-        if(map->compareKeys(node->key, curr->key) < 0)
+        spares[i] = NodeCreate(false);
+        if(spares[i] == NULL)
         {
-            if(curr == map->head)
-            {
-                node->next = map->head;
-                map->head = node;
-            }
-            else
-            {
-                node->next = curr;
-                prev->next = node;
-            }
-            return;
+            while(i-- > 0)
+                NodeFree(spares[i]);
+            return MAP_OUT_OF_MEMORY;
         }
     }
-    map->tail->next = node;
-    node->next = NULL;
-    map->tail = node;
+    STATS_ADD(map, allocations, needed);
+
+    map->version++;
+    mapThaw(map);
+    Node rightChild = NULL;
+    for(int level = path->depth; level >= 0; level--)
+    {
+        Node node = path->nodes[level];
+        insertIntoNode(node, path->indices[level], key, data, rightChild);
+        if(node->size <= MAX_ELEMENTS)
+            return MAP_SUCCESS;
+
+        rightChild = spares[--needed];
+        rightChild->isLeaf = node->isLeaf;
+        splitNode(node, rightChild);
+        key = node->keys[MIN_DEGREE];
+        data = node->data[MIN_DEGREE];
+    }
+
+    Node newRoot = spares[--needed];
+    newRoot->keys[0] = key;
+    newRoot->data[0] = data;
+    newRoot->children[0] = map->root;
+    newRoot->children[1] = rightChild;
+    newRoot->size = 1;
+    map->root = newRoot;
+    return MAP_SUCCESS;
 }
 
-MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+// moves the last element of the left sibling of parent->children[index] through the parent into it
+static void rotateRight(Node parent, int index)
 {
-    if( !map || !keyElement || !dataElement)
-        return MAP_NULL_ARGUMENT;
+    Node node = parent->children[index];
+    Node left = parent->children[index - 1];
+    memmove(node->keys + 1, node->keys, node->size * sizeof(*node->keys));
+    memmove(node->data + 1, node->data, node->size * sizeof(*node->data));
+    if(!node->isLeaf)
+    {
+        memmove(node->children + 1, node->children, (node->size + 1) * sizeof(*node->children));
+        node->children[0] = left->children[left->size];
+    }
+    node->keys[0] = parent->keys[index - 1];
+    node->data[0] = parent->data[index - 1];
+    node->size++;
+    parent->keys[index - 1] = left->keys[left->size - 1];
+    parent->data[index - 1] = left->data[left->size - 1];
+    left->size--;
+}
+
+// moves the first element of the right sibling of parent->children[index] through the parent into it
+static void rotateLeft(Node parent, int index)
+{
+    Node node = parent->children[index];
+    Node right = parent->children[index + 1];
+    insertIntoNode(node, node->size, parent->keys[index], parent->data[index], right->children[0]);
+    parent->keys[index] = right->keys[0];
+    parent->data[index] = right->data[0];
+    if(!right->isLeaf)
+        memmove(right->children, right->children + 1, right->size * sizeof(*right->children));
+    right->size--;
+    memmove(right->keys, right->keys + 1, right->size * sizeof(*right->keys));
+    memmove(right->data, right->data + 1, right->size * sizeof(*right->data));
+}
+
+// merges parent->children[index + 1] and the element separating them into parent->children[index]
+static void mergeChildren(Node parent, int index)
+{
+    Node left = parent->children[index];
+    Node right = parent->children[index + 1];
+    left->keys[left->size] = parent->keys[index];
+    left->data[left->size] = parent->data[index];
+    memcpy(left->keys + left->size + 1, right->keys, right->size * sizeof(*right->keys));
+    memcpy(left->data + left->size + 1, right->data, right->size * sizeof(*right->data));
+    if(!left->isLeaf)
+        memcpy(left->children + left->size + 1, right->children, (right->size + 1) * sizeof(*right->children));
+    left->size += right->size + 1;
+    removeFromNode(parent, index);
+    NodeFree(right);
+}
 
-    Node node = findElement(map, keyElement);
-    if( node == NULL )
+/**
+ * Extends a path found by findPrivatePath down to the predecessor of its element when the element is
+ * in an inner node, and makes private every node removeAtPath is going to change: the nodes down to
+ * the predecessor and the siblings that will lend an element or be merged. The fixing is predicted
+ * the same way removeAtPath does it, so the removal itself cannot fail half way.
+ */
+static MapResult prepareRemoval(Map map, Path* path)
+{
+    Node node = path->nodes[path->depth];
+    if(!node->isLeaf)
     {
-        node = NodeCreate(map, keyElement, dataElement);
-        if(node == NULL)
+        Node* link = &node->children[path->indices[path->depth]];
+        while(true)
+        {
+            Node child = privateNode(map, link);
+            if(child == NULL)
+                return MAP_OUT_OF_MEMORY;
+            path->depth++;
+            path->nodes[path->depth] = child;
+            path->indices[path->depth] = child->isLeaf ? child->size - 1 : child->size;
+            if(child->isLeaf)
+                break;
+            link = &child->children[child->size];
+        }
+    }
+
+    for(int level = path->depth; level > 0 && path->nodes[level]->size <= MIN_ELEMENTS; level--)
+    {
+        Node parent = path->nodes[level - 1];
+        int childIndex = path->indices[level - 1];
+        int sibling;
+        bool rotates = true;
+        if(childIndex > 0 && parent->children[childIndex - 1]->size > MIN_ELEMENTS)
+            sibling = childIndex - 1;
+        else if(childIndex < parent->size && parent->children[childIndex + 1]->size > MIN_ELEMENTS)
+            sibling = childIndex + 1;
+        else
+        {
+            sibling = childIndex > 0 ? childIndex - 1 : childIndex + 1;
+            rotates = false;
+        }
+        if(privateNode(map, &parent->children[sibling]) == NULL)
             return MAP_OUT_OF_MEMORY;
-        addNonExistingNode(map, node);
-        map->size += 1;
+        // a rotation does not shrink the parent, only a merge goes on upwards
+        if(rotates)
+            break;
     }
+    return MAP_SUCCESS;
+}
+
+/**
+ * Unlinks the element at level target of a path prepared by prepareRemoval and frees it.
+ * An element of an inner node is replaced by its predecessor, at the deepest level of the path,
+ * and then the nodes that became too small are fixed from the leaf upwards using the recorded path.
+ */
+static void removeAtPath(Map map, Path* path, int target)
+{
+    Node node = path->nodes[target];
+    int index = path->indices[target];
+    map->freeData(node->data[index]);
+    map->freeKey(node->keys[index]);
+
+    Node leaf = path->nodes[path->depth];
+    if(leaf == node)
+        removeFromNode(node, index);
     else
     {
-        map->freeData(node->data);
-        node->data = map->copyData(dataElement);
+        node->keys[index] = leaf->keys[leaf->size - 1];
+        node->data[index] = leaf->data[leaf->size - 1];
+        leaf->size--;
     }
-    return MAP_SUCCESS;
+
+    for(int level = path->depth; level > 0 && path->nodes[level]->size < MIN_ELEMENTS; level--)
+    {
+        Node parent = path->nodes[level - 1];
+        int childIndex = path->indices[level - 1];
+        if(childIndex > 0 && parent->children[childIndex - 1]->size > MIN_ELEMENTS)
+            rotateRight(parent, childIndex);
+        else if(childIndex < parent->size && parent->children[childIndex + 1]->size > MIN_ELEMENTS)
+            rotateLeft(parent, childIndex);
+        else
+            mergeChildren(parent, childIndex > 0 ? childIndex - 1 : childIndex);
+    }
+
+    Node root = map->root;
+    if(root->size == 0)
+    {
+        map->root = root->isLeaf ? NULL : root->children[0];
+        NodeFree(root);
+    }
+    map->version++;
+    mapThaw(map);
 }
 
-MapDataElement mapGet(Map map, MapKeyElement keyElement)
+// moves a cursor whose element was removed to the removed element's successor next, see mapCursorNext
+static void cursorSkipRemoved(MapCursor* cursor, MapKeyElement next)
 {
-    if( !map || !keyElement|| !findElement(map, keyElement))
-        return NULL;
-    return findElement(map, keyElement)->data;
+    cursor->removed = true;
+    cursor->path.depth = -1;
+    if(next != NULL)
+        pathSeek(cursor->map, next, &cursor->path);
+    cursor->key = pathKey(&cursor->path);
+    cursor->version = cursor->map->version;
 }
 
-void mapDestroy(Map map)
+/**
+ * Removes the element a private path found by findPrivatePath points at, without searching for it again.
+ * cursor, when not NULL, and the internal iterator, when it stands on the element (as it does when the
+ * element is removed inside MAP_FOREACH), are moved so their next step returns the element's successor.
+ */
+static MapResult removePath(Map map, Path* path, MapCursor* cursor)
 {
-    if(map == NULL)
-        return;
+    MapKeyElement removed = pathKey(path);
+    MapCursor* iterator = &map->iterator;
+    bool iteratorOnIt = iterator != cursor && iterator->map == map && iterator->path.depth >= 0
+                        && !iterator->removed && compareElements(map, iterator->key, removed) == 0;
+    // keys are never freed by the removal of another key, so the successor can be found again after it
+    Path successor = *path;
+    pathNext(&successor);
+    MapKeyElement next = pathKey(&successor);
+
+    int target = path->depth;
+    if(prepareRemoval(map, path) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+    if(map->hashKey != NULL)
+        indexRemove(map, indexFindKey(map, removed));
+    removeAtPath(map, path, target);
+    map->size -= 1;
 
-    deleteNodesList(map);
-    free(map);
+    if(cursor != NULL)
+        cursorSkipRemoved(cursor, next);
+    if(iteratorOnIt)
+        cursorSkipRemoved(iterator, next);
+    return MAP_SUCCESS;
 }
 
-MapResult mapClear(Map map)
+//mapRemove: Removes a pair of key and data elements from the map.
+MapResult mapRemove(Map map, MapKeyElement keyElement)
 {
-    if(map == NULL)
+    if(map == NULL || keyElement == NULL)
+    {
         return MAP_NULL_ARGUMENT;
+    }
+    // a key that is missing must not cost the cloning of its path
+    if((map->hashKey != NULL || isShared(map)) && !mapContains(map, keyElement))
+        return MAP_ITEM_DOES_NOT_EXIST;
 
-    deleteNodesList(map);
-    map->head = map->tail = NULL;
-    map->size = 0;
+    Path path;
+    bool found;
+    if(findPrivatePath(map, keyElement, &path, &found) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+    if(!found)
+        return MAP_ITEM_DOES_NOT_EXIST;
+    return removePath(map, &path, NULL);
+}
+
+/**
+ * Replaces the data of the element path points at with dataElement itself when takeData is set,
+ * with a copy of it otherwise. The old data is freed.
+ */
+static MapResult setDataAtPath(Map map, Path* path, MapDataElement dataElement, bool takeData)
+{
+    Node node = path->nodes[path->depth];
+    int index = path->indices[path->depth];
+    MapDataElement newData = takeData ? dataElement : copyDataElement(map, dataElement);
+    if(newData == NULL)
+        return MAP_OUT_OF_MEMORY;
+    if(newData != node->data[index])
+    {
+        mapThaw(map);
+        map->freeData(node->data[index]);
+    }
+    node->data[index] = newData;
+    if(map->hashKey != NULL)
+    {
+        map->index->slots[indexFindKey(map, node->keys[index])].data = newData;
+    }
     return MAP_SUCCESS;
 }
 
-int mapGetSize(Map map) { return !map ? -1 : map->size; }
+/**
+ * Inserts a copy of keyElement with dataElement (or a copy of it, see setDataAtPath) at the leaf slot
+ * recorded by a failed findPath. On failure nothing the caller passed is freed.
+ */
+static MapResult insertAtPathElements(Map map, Path* path, MapKeyElement keyElement, MapDataElement dataElement,
+                                      bool takeData, MapDataElement* inserted)
+{
+    if(indexPrepare(map, 1) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+    MapKeyElement newKey = copyKeyElement(map, keyElement);
+    if(newKey == NULL)
+        return MAP_OUT_OF_MEMORY;
+    MapDataElement newData = takeData ? dataElement : copyDataElement(map, dataElement);
+    if(newData == NULL)
+    {
+        map->freeKey(newKey);
+        return MAP_OUT_OF_MEMORY;
+    }
+    if(insertAtPath(map, path, newKey, newData) != MAP_SUCCESS)
+    {
+        if(!takeData)
+            map->freeData(newData);
+        map->freeKey(newKey);
+        return MAP_OUT_OF_MEMORY;
+    }
+    if(map->hashKey != NULL)
+        indexInsert(map, newKey, newData, mixHash(map->hashKey(newKey)));
+    map->size += 1;
+    statsUpdatePeak(map);
+    if(inserted != NULL)
+        *inserted = newData;
+    return MAP_SUCCESS;
+}
 
-bool mapContains(Map map, MapKeyElement element)
+static MapResult putElements(Map map, MapKeyElement keyElement, MapDataElement dataElement, bool takeData)
 {
-    if( !map || !element)
-        return false;
-    return findElement(map, element) == NULL ? false : true;
+    if( !map || !keyElement || !dataElement)
+        return MAP_NULL_ARGUMENT;
+
+    Path path;
+    bool found;
+    if(findPrivatePath(map, keyElement, &path, &found) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+    if(found)
+        return setDataAtPath(map, &path, dataElement, takeData);
+    return insertAtPathElements(map, &path, keyElement, dataElement, takeData, NULL);
 }
 
+MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    return putElements(map, keyElement, dataElement, false);
+}
 
-MapKeyElement mapGetFirst(Map map)
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement)
 {
-    if( !map|| !map->head)
-        return NULL;
+    return putElements(map, keyElement, dataElement, true);
+}
+
+/** Note on batches:
+ * A batch that is large compared to the map is merged into it: the elements of the map and the sorted
+ * batch are merged into one sorted array and the tree is rebuilt from it bottom up, which costs
+ * O(size of map + size of batch) instead of a search per pair. A small batch is put pair by pair.
+ */
+#define BATCH_MERGE_RATIO 8
+
+/**
+ * Fills order with the indices of keys sorted by key, keeping only the last of equal keys so the batch
+ * behaves like putting its pairs one after the other. buffer has room for size indices.
+ * Returns the number of indices left in order.
+ */
+static int sortBatch(Map map, MapKeyElement* keys, int* order, int* buffer, int size)
+{
+    bool sorted = true;
+    for(int i = 0; i < size; i++)
+    {
+        order[i] = i;
+        sorted = sorted && (i == 0 || compareElements(map, keys[i - 1], keys[i]) < 0);
+    }
+    if(sorted)
+        return size;
+
+    // bottom up merge sort, stable so the order of equal keys is kept
+    int* from = order;
+    int* to = buffer;
+    for(int width = 1; width < size; width *= 2)
+    {
+        for(int low = 0; low < size; low += 2 * width)
+        {
+            int middle = low + width < size ? low + width : size;
+            int high = low + 2 * width < size ? low + 2 * width : size;
+            int i = low, j = middle, k = low;
+            while(i < middle && j < high)
+                to[k++] = compareElements(map, keys[from[j]], keys[from[i]]) < 0 ? from[j++] : from[i++];
+            while(i < middle)
+                to[k++] = from[i++];
+            while(j < high)
+                to[k++] = from[j++];
+        }
+        int* temp = from;
+        from = to;
+        to = temp;
+    }
 
-    map->iterator = map->head;
-    return map->iterator == NULL ? NULL :  map->copyKey(map->iterator->key);
+    int unique = 0;
+    for(int i = 0; i < size; i++)
+    {
+        if(i + 1 < size && compareElements(map, keys[from[i]], keys[from[i + 1]]) == 0)
+            continue;
+        order[unique++] = from[i];
+    }
+    return unique;
 }
 
+// the number of nodes buildTree uses for size elements
+static int countTreeNodes(int size)
+{
+    int count = 0;
+    int slots = size + 1;
+    while(size > 0)
+    {
+        int nodes = (slots + MAX_ELEMENTS) / (MAX_ELEMENTS + 1);
+        count += nodes;
+        if(nodes == 1)
+            break;
+        slots = nodes;
+    }
+    return count;
+}
 
-MapKeyElement mapGetNext(Map map)
+/**
+ * Builds a tree of the size sorted elements of keys and data, level by level from the leaves up.
+ * The slots of a level (its elements and the gaps between them, that is the children of the level)
+ * are split evenly between as few nodes as possible and the element after every node but the last
+ * moves up to the level above. With at least MAX_ELEMENTS + 1 slots every node gets MIN_ELEMENTS or more.
+ * The nodes are taken from the front of nodes, which also holds the children of the level being built:
+ * a level only overwrites entries it has already read. keys and data are reused the same way.
+ */
+static Node buildTree(MapKeyElement* keys, MapDataElement* data, int size, Node* nodes)
 {
-    if( !map|| !map->iterator)
+    if(size == 0)
         return NULL;
 
-    map->iterator = map->iterator->next;
-    return map->iterator == NULL ? NULL :  map->copyKey(map->iterator->key);
+    Node* spares = nodes;
+    bool isLeaf = true;
+    int slots = size + 1;
+    while(true)
+    {
+        int count = (slots + MAX_ELEMENTS) / (MAX_ELEMENTS + 1);
+        int element = 0, child = 0;
+        for(int i = 0; i < count; i++)
+        {
+            Node node = *spares++;
+            int nodeSlots = slots / count + (i < slots % count);
+            node->isLeaf = isLeaf;
+            node->size = nodeSlots - 1;
+            memcpy(node->keys, keys + element, node->size * sizeof(*keys));
+            memcpy(node->data, data + element, node->size * sizeof(*data));
+            if(!isLeaf)
+                memcpy(node->children, nodes + child, nodeSlots * sizeof(*nodes));
+            element += node->size;
+            child += nodeSlots;
+            if(i < count - 1)
+            {
+                keys[i] = keys[element];
+                data[i] = data[element];
+                element++;
+            }
+            nodes[i] = node;
+        }
+        if(count == 1)
+            return nodes[0];
+        isLeaf = false;
+        slots = count;
+    }
 }
 
+// releases the nodes of a private tree whose elements were moved elsewhere
+static void NodeFreeTree(Node node)
+{
+    if(node == NULL)
+        return;
+    if(!node->isLeaf)
+    {
+        for(int i = 0; i <= node->size; i++)
+            NodeFreeTree(node->children[i]);
+    }
+    NodeFree(node);
+}
+
+// makes every node of the subtree *link points at private to map, the index must be private already
+static MapResult privateTree(Map map, Node* link)
+{
+    Node node = privateNode(map, link);
+    if(node == NULL)
+        return MAP_OUT_OF_MEMORY;
+    if(!node->isLeaf)
+    {
+        for(int i = 0; i <= node->size; i++)
+        {
+            if(privateTree(map, &node->children[i]) != MAP_SUCCESS)
+                return MAP_OUT_OF_MEMORY;
+        }
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * Merges the pairs of the batch, in the order sortBatch found, with the map and rebuilds the tree.
+ * Everything that can fail is done before the map is touched.
+ */
+static MapResult mergeBatch(Map map, MapKeyElement* keys, MapDataElement* values, int* order, int size)
+{
+    if(indexPrepare(map, size) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+    if(map->root != NULL && isShared(map) && privateTree(map, &map->root) != MAP_SUCCESS)
+        return MAP_OUT_OF_MEMORY;
+
+    int total = map->size + size;
+    int nodesCount = countTreeNodes(total);
+    void** elements = malloc((2 * total + 2 * size) * sizeof(*elements));
+    Node* nodes = malloc(nodesCount * sizeof(*nodes));
+    if(elements == NULL || nodes == NULL)
+    {
+        free(elements);
+        free(nodes);
+        return MAP_OUT_OF_MEMORY;
+    }
+    MapKeyElement* mergedKeys = elements;
+    MapDataElement* mergedData = mergedKeys + total;
+    MapKeyElement* batchKeys = mergedData + total;
+    MapDataElement* batchData = batchKeys + size;
+
+    int copied = 0, created = 0;
+    for(; copied < size; copied++)
+    {
+        batchKeys[copied] = copyKeyElement(map, keys[order[copied]]);
+        batchData[copied] = batchKeys[copied] == NULL ? NULL : copyDataElement(map, values[order[copied]]);
+        if(batchData[copied] == NULL)
+            break;
+    }
+    for(; created < nodesCount && copied == size; created++)
+    {
+        nodes[created] = NodeCreate(true);
+        if(nodes[created] == NULL)
+            break;
+    }
+    if(copied < size || created < nodesCount)
+    {
+        if(copied < size && batchKeys[copied] != NULL)
+            map->freeKey(batchKeys[copied]);
+        for(int i = 0; i < copied; i++)
+        {
+            map->freeKey(batchKeys[i]);
+            map->freeData(batchData[i]);
+        }
+        while(created-- > 0)
+            NodeFree(nodes[created]);
+        free(elements);
+        free(nodes);
+        return MAP_OUT_OF_MEMORY;
+    }
+
+    // a batch pair replacing a pair of the map leaves the replaced pair in its batch slot to be freed
+    Path path;
+    pathFirst(map, &path);
+    int merged = 0;
+    for(int j = 0; path.depth >= 0 || j < size; merged++)
+    {
+        int result = path.depth < 0 ? 1 : j == size ? -1 : compareElements(map, pathKey(&path), batchKeys[j]);
+        if(result < 0)
+        {
+            mergedKeys[merged] = pathKey(&path);
+            mergedData[merged] = pathData(&path);
+            pathNext(&path);
+            continue;
+        }
+        mergedKeys[merged] = batchKeys[j];
+        mergedData[merged] = batchData[j];
+        batchKeys[j] = NULL;
+        if(result == 0)
+        {
+            batchKeys[j] = pathKey(&path);
+            batchData[j] = pathData(&path);
+            pathNext(&path);
+        }
+        j++;
+    }
+
+    NodeFreeTree(map->root);
+    map->root = buildTree(mergedKeys, mergedData, merged, nodes);
+    for(int i = countTreeNodes(merged); i < nodesCount; i++)
+        NodeFree(nodes[i]);
+    for(int j = 0; j < size; j++)
+    {
+        if(batchKeys[j] != NULL)
+        {
+            map->freeData(batchData[j]);
+            map->freeKey(batchKeys[j]);
+        }
+    }
+    map->size = merged;
+    map->version++;
+    mapThaw(map);
+    STATS_ADD(map, allocations, countTreeNodes(merged));
+    statsUpdatePeak(map);
+    free(elements);
+    free(nodes);
+
+    if(map->hashKey != NULL)
+    {
+        memset(map->index->slots, 0, map->index->capacity * sizeof(*map->index->slots));
+        for(pathFirst(map, &path); path.depth >= 0; pathNext(&path))
+            indexInsert(map, pathKey(&path), pathData(&path), mixHash(map->hashKey(pathKey(&path))));
+    }
+    return MAP_SUCCESS;
+}
+
+MapResult mapPutBatch(Map map, MapKeyElement* keys, MapDataElement* values, int size)
+{
+    if(!map || ((!keys || !values) && size > 0))
+        return MAP_NULL_ARGUMENT;
+    for(int i = 0; i < size; i++)
+    {
+        if(!keys[i] || !values[i])
+            return MAP_NULL_ARGUMENT;
+    }
+    if(size <= 0)
+        return MAP_SUCCESS;
+
+    if(size < map->size / BATCH_MERGE_RATIO)
+    {
+        for(int i = 0; i < size; i++)
+        {
+            MapResult result = putElements(map, keys[i], values[i], false);
+            if(result != MAP_SUCCESS)
+                return result;
+        }
+        return MAP_SUCCESS;
+    }
+
+    int* order = malloc(2 * size * sizeof(*order));
+    if(order == NULL)
+        return MAP_OUT_OF_MEMORY;
+    int unique = sortBatch(map, keys, order, order + size, size);
+    MapResult result = mergeBatch(map, keys, values, order, unique);
+    free(order);
+    return result;
+}
+
+Map mapCreateFromSorted(copyMapDataElements copyDataElement, copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement, freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements, MapKeyElement* keys, MapDataElement* values, int size)
+{
+    Map map = mapCreate(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement, compareKeyElements);
+    if(map == NULL)
+        return NULL;
+
+    if(mapPutBatch(map, keys, values, size) != MAP_SUCCESS)
+    {
+        mapDestroy(map);
+        return NULL;
+    }
+    return map;
+}
+
+typedef enum set_operation_t {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE
+} SetOperation;
+
+/**
+ * Walks the keys of both maps in order at once, like the merge step of merge sort, collecting the pairs
+ * the operation keeps already sorted, and builds the result from them with mapPutBatch, which finds them
+ * sorted and builds its tree in linear time. Pairs are taken from first, for keys in both maps the union
+ * takes them from second, as putting second over a copy of first would.
+ */
+static Map setOperation(Map first, Map second, SetOperation operation)
+{
+    if(!first || !second)
+        return NULL;
+    Map result = first->hashKey != NULL ?
+                 mapCreateHashed(first->copyData, first->copyKey, first->freeData, first->freeKey,
+                                 first->compareKeys, first->hashKey) :
+                 mapCreate(first->copyData, first->copyKey, first->freeData, first->freeKey, first->compareKeys);
+    int capacity = operation == SET_UNION ? first->size + second->size : first->size;
+    if(result == NULL || capacity == 0)
+        return result;
+
+    MapKeyElement* keys = malloc(capacity * sizeof(*keys));
+    MapDataElement* values = malloc(capacity * sizeof(*values));
+    if(keys == NULL || values == NULL)
+    {
+        free(keys);
+        free(values);
+        mapDestroy(result);
+        return NULL;
+    }
+
+    Path firstPath, secondPath;
+    pathFirst(first, &firstPath);
+    pathFirst(second, &secondPath);
+    int count = 0;
+    while(firstPath.depth >= 0)
+    {
+        MapKeyElement key = pathKey(&firstPath);
+        int order = secondPath.depth < 0 ? -1 : compareElements(first, key, pathKey(&secondPath));
+        if(order > 0)
+        {
+            if(operation == SET_UNION)
+            {
+                keys[count] = pathKey(&secondPath);
+                values[count++] = pathData(&secondPath);
+            }
+            pathNext(&secondPath);
+            continue;
+        }
+        bool inSecond = order == 0;
+        if(operation == SET_UNION || (operation == SET_INTERSECTION) == inSecond)
+        {
+            keys[count] = key;
+            values[count++] = operation == SET_UNION && inSecond ? pathData(&secondPath) : pathData(&firstPath);
+        }
+        if(inSecond)
+            pathNext(&secondPath);
+        pathNext(&firstPath);
+    }
+    for(; operation == SET_UNION && secondPath.depth >= 0; pathNext(&secondPath))
+    {
+        keys[count] = pathKey(&secondPath);
+        values[count++] = pathData(&secondPath);
+    }
+
+    MapResult built = mapPutBatch(result, keys, values, count);
+    free(keys);
+    free(values);
+    if(built != MAP_SUCCESS)
+    {
+        mapDestroy(result);
+        return NULL;
+    }
+    return result;
+}
+
+Map mapMerge(Map first, Map second)
+{
+    return setOperation(first, second, SET_UNION);
+}
+
+Map mapIntersect(Map first, Map second)
+{
+    return setOperation(first, second, SET_INTERSECTION);
+}
+
+Map mapDifference(Map first, Map second)
+{
+    return setOperation(first, second, SET_DIFFERENCE);
+}
+
+// fills the Eytzinger subtree rooted at slot position with the next elements of an in-order walk
+static void frozenFill(Frozen frozen, int size, int position, Path* path)
+{
+    if(position > size)
+        return;
+    frozenFill(frozen, size, 2 * position, path);
+    frozen->keys[position] = pathKey(path);
+    frozen->data[position] = pathData(path);
+    pathNext(path);
+    frozenFill(frozen, size, 2 * position + 1, path);
+}
+
+/**
+ * Returns the slot of the frozen layout holding element, 0 if there is none.
+ * The descent adds the result of the comparison to the next position instead of branching on it, so
+ * the loop has the same shape for every key. Once it falls off the bottom, the slot of the smallest key
+ * not smaller than element is the last one it went left at: removing the trailing right turns (1 bits)
+ * and that left turn from the position gives it.
+ */
+static int frozenFind(Map map, MapKeyElement element)
+{
+    STATS_ADD(map, searches, 1);
+    MapKeyElement* keys = map->frozen->keys;
+    unsigned int size = map->size;
+    unsigned int position = 1;
+    while(position <= size)
+    {
+        MAP_PREFETCH(keys + 16 * position);
+        position = 2 * position + (compareElements(map, keys[position], element) < 0);
+    }
+    while(position & 1)
+        position >>= 1;
+    position >>= 1;
+    if(position == 0 || compareElements(map, keys[position], element) != 0)
+        return 0;
+    return position;
+}
+
+MapResult mapFreeze(Map map)
+{
+    if(map == NULL)
+        return MAP_NULL_ARGUMENT;
+    if(map->frozen != NULL)
+        return MAP_SUCCESS;
+
+    Frozen frozen = malloc(sizeof(*frozen));
+    if(frozen == NULL)
+        return MAP_OUT_OF_MEMORY;
+    frozen->keys = malloc((map->size + 1) * sizeof(*frozen->keys));
+    frozen->data = malloc((map->size + 1) * sizeof(*frozen->data));
+    if(frozen->keys == NULL || frozen->data == NULL)
+    {
+        free(frozen->keys);
+        free(frozen->data);
+        free(frozen);
+        return MAP_OUT_OF_MEMORY;
+    }
+    STATS_ADD(map, allocations, 1);
+    Path path;
+    pathFirst(map, &path);
+    frozenFill(frozen, map->size, 1, &path);
+    map->frozen = frozen;
+    return MAP_SUCCESS;
+}
+
+bool mapIsFrozen(Map map)
+{
+    return map != NULL && map->frozen != NULL;
+}
+
+/** Note on mapGetMany:
+ * A lookup is a chain of dependent loads, the next node is known only once the current one arrived.
+ * mapGetMany runs the lookups of GET_MANY_LANES keys side by side, one level of all of them per round,
+ * and requests the next node of every lookup before working on the others, so the cache misses of
+ * the lookups overlap instead of following one another.
+ */
+#define GET_MANY_LANES 8
+
+static void getManyTree(Map map, MapKeyElement* keys, int lanes, MapDataElement* out)
+{
+    Node nodes[GET_MANY_LANES];
+    int active = 0;
+    for(int i = 0; i < lanes; i++)
+    {
+        out[i] = NULL;
+        nodes[i] = keys[i] == NULL ? NULL : map->root;
+        active += nodes[i] != NULL;
+        STATS_ADD(map, searches, nodes[i] != NULL);
+    }
+    while(active > 0)
+    {
+        active = 0;
+        for(int i = 0; i < lanes; i++)
+        {
+            Node node = nodes[i];
+            if(node == NULL)
+                continue;
+            bool found;
+            int index = searchNode(map, node, keys[i], &found);
+            if(found)
+                out[i] = node->data[index];
+            nodes[i] = found || node->isLeaf ? NULL : node->children[index];
+            if(nodes[i] != NULL)
+            {
+                MAP_PREFETCH(nodes[i]);
+                MAP_PREFETCH(nodes[i]->keys + MAX_ELEMENTS / 2);
+                active++;
+            }
+        }
+    }
+}
+
+static void getManyFrozen(Map map, MapKeyElement* keys, int lanes, MapDataElement* out)
+{
+    MapKeyElement* frozenKeys = map->frozen->keys;
+    unsigned int size = map->size;
+    unsigned int positions[GET_MANY_LANES];
+    int active = 0;
+    for(int i = 0; i < lanes; i++)
+    {
+        positions[i] = keys[i] == NULL ? size + 1 : 1;
+        active += keys[i] != NULL;
+        STATS_ADD(map, searches, keys[i] != NULL);
+    }
+    // the same descent as frozenFind, one level of every key per round
+    while(active > 0)
+    {
+        active = 0;
+        for(int i = 0; i < lanes; i++)
+        {
+            unsigned int position = positions[i];
+            if(position > size)
+                continue;
+            position = 2 * position + (compareElements(map, frozenKeys[position], keys[i]) < 0);
+            MAP_PREFETCH(frozenKeys + 16 * position);
+            positions[i] = position;
+            active += position <= size;
+        }
+    }
+    for(int i = 0; i < lanes; i++)
+    {
+        unsigned int position = positions[i];
+        while(position & 1)
+            position >>= 1;
+        position >>= 1;
+        bool found = keys[i] != NULL && position != 0 && compareElements(map, frozenKeys[position], keys[i]) == 0;
+        out[i] = found ? map->frozen->data[position] : NULL;
+    }
+}
+
+static void getManyIndexed(Map map, MapKeyElement* keys, int lanes, MapDataElement* out)
+{
+    // an empty hashed map has no index yet
+    if(map->index == NULL)
+    {
+        for(int i = 0; i < lanes; i++)
+            out[i] = NULL;
+        return;
+    }
+    unsigned int hashes[GET_MANY_LANES];
+    int mask = map->index->capacity - 1;
+    for(int i = 0; i < lanes; i++)
+    {
+        if(keys[i] == NULL)
+            continue;
+        hashes[i] = mixHash(map->hashKey(keys[i]));
+        MAP_PREFETCH(map->index->slots + (hashes[i] & mask));
+    }
+    for(int i = 0; i < lanes; i++)
+    {
+        int slot = keys[i] == NULL ? -1 : indexFind(map, keys[i], hashes[i]);
+        out[i] = slot < 0 ? NULL : map->index->slots[slot].data;
+    }
+}
+
+MapResult mapGetMany(Map map, MapKeyElement* keys, int count, MapDataElement* out)
+{
+    if(!map || !keys || !out)
+        return MAP_NULL_ARGUMENT;
+
+    if(isShared(map))
+    {
+        // the data is handed out to be modified in place, mapGet makes every path private first
+        for(int i = 0; i < count; i++)
+            out[i] = keys[i] == NULL ? NULL : mapGet(map, keys[i]);
+        return MAP_SUCCESS;
+    }
+    for(int first = 0; first < count; first += GET_MANY_LANES)
+    {
+        int lanes = count - first < GET_MANY_LANES ? count - first : GET_MANY_LANES;
+        if(map->hashKey != NULL)
+            getManyIndexed(map, keys + first, lanes, out + first);
+        else if(map->frozen != NULL)
+            getManyFrozen(map, keys + first, lanes, out + first);
+        else
+            getManyTree(map, keys + first, lanes, out + first);
+    }
+    return MAP_SUCCESS;
+}
+
+// marks the path of an entry whose search ran out of memory
+#define ENTRY_SEARCH_FAILED (-2)
+
+bool mapEntryFind(Map map, MapKeyElement keyElement, MapEntry* entry)
+{
+    if(!entry)
+        return false;
+    entry->map = map;
+    entry->data = NULL;
+    entry->found = false;
+    if(!map || !keyElement)
+        return false;
+
+    // the data of the entry may be modified in place, so its path must not be shared with a copy
+    if(findPrivatePath(map, keyElement, &entry->path, &entry->found) != MAP_SUCCESS)
+    {
+        entry->found = false;
+        entry->path.depth = ENTRY_SEARCH_FAILED;
+        return false;
+    }
+    entry->version = map->version;
+    if(entry->found)
+        entry->data = pathData(&entry->path);
+    return entry->found;
+}
+
+MapDataElement mapEntryGet(MapEntry* entry)
+{
+    return entry == NULL ? NULL : entry->data;
+}
+
+static MapResult entryInsert(MapEntry* entry, MapKeyElement keyElement, MapDataElement dataElement, bool takeData)
+{
+    if(!entry || !entry->map || !keyElement || !dataElement)
+        return MAP_NULL_ARGUMENT;
+    if(entry->found)
+        return MAP_ITEM_ALREADY_EXISTS;
+    if(entry->path.depth == ENTRY_SEARCH_FAILED)
+        return MAP_OUT_OF_MEMORY;
+    if(entry->version != entry->map->version)
+        return MAP_ERROR;
+
+    // splits may move the element, so the version it bumps leaves only mapEntryGet usable afterwards
+    MapResult result = insertAtPathElements(entry->map, &entry->path, keyElement, dataElement, takeData, &entry->data);
+    if(result != MAP_SUCCESS)
+        return result;
+    entry->found = true;
+    return MAP_SUCCESS;
+}
+
+MapResult mapEntryInsert(MapEntry* entry, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    return entryInsert(entry, keyElement, dataElement, false);
+}
+
+MapResult mapEntryInsertTake(MapEntry* entry, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    return entryInsert(entry, keyElement, dataElement, true);
+}
+
+MapResult mapEntrySet(MapEntry* entry, MapDataElement dataElement)
+{
+    if(!entry || !entry->map || !dataElement)
+        return MAP_NULL_ARGUMENT;
+    if(!entry->found)
+        return MAP_ITEM_DOES_NOT_EXIST;
+    if(entry->version != entry->map->version)
+        return MAP_ERROR;
+
+    MapResult result = setDataAtPath(entry->map, &entry->path, dataElement, false);
+    if(result == MAP_SUCCESS)
+        entry->data = pathData(&entry->path);
+    return result;
+}
+
+MapResult mapEntryRemove(MapEntry* entry)
+{
+    if(!entry || !entry->map)
+        return MAP_NULL_ARGUMENT;
+    if(!entry->found)
+        return MAP_ITEM_DOES_NOT_EXIST;
+    if(entry->version != entry->map->version)
+        return MAP_ERROR;
+
+    MapResult result = removePath(entry->map, &entry->path, NULL);
+    if(result != MAP_SUCCESS)
+        return result;
+    entry->found = false;
+    entry->data = NULL;
+    return MAP_SUCCESS;
+}
+
+MapDataElement mapGetOrPut(Map map, MapKeyElement keyElement, MapDataElement dataElement)
+{
+    if(!map || !keyElement || !dataElement)
+        return NULL;
+
+    MapEntry entry;
+    if(!mapEntryFind(map, keyElement, &entry) && mapEntryInsert(&entry, keyElement, dataElement) != MAP_SUCCESS)
+        return NULL;
+    return mapEntryGet(&entry);
+}
+
+MapDataElement mapPeek(Map map, MapKeyElement keyElement)
+{
+    if( !map || !keyElement)
+        return NULL;
+    if(map->hashKey != NULL)
+    {
+        int slot = indexFindKey(map, keyElement);
+        return slot < 0 ? NULL : map->index->slots[slot].data;
+    }
+    if(map->frozen != NULL)
+    {
+        int slot = frozenFind(map, keyElement);
+        return slot == 0 ? NULL : map->frozen->data[slot];
+    }
+    int index;
+    Node node = findNode(map, keyElement, &index);
+    return node == NULL ? NULL : node->data[index];
+}
+
+MapDataElement mapGet(Map map, MapKeyElement keyElement)
+{
+    if( !map || !keyElement)
+        return NULL;
+    if(!isShared(map))
+        return mapPeek(map, keyElement);
+
+    // the caller may modify the data in place, the copies of the map must not see it
+    Path path;
+    bool found;
+    if(!mapContains(map, keyElement) || findPrivatePath(map, keyElement, &path, &found) != MAP_SUCCESS)
+        return NULL;
+    return pathData(&path);
+}
+
+void mapDestroy(Map map)
+{
+    if(map == NULL)
+        return;
+
+    NodeRelease(map->root, map);
+    indexRelease(map->index);
+    if(map->lineage != NULL && --*map->lineage == 0)
+        free(map->lineage);
+    mapThaw(map);
+    free(map->stats);
+    poolFree(&mapPool, map);
+}
+
+MapResult mapClear(Map map)
+{
+    if(map == NULL)
+        return MAP_NULL_ARGUMENT;
+
+    NodeRelease(map->root, map);
+    map->root = NULL;
+    map->iterator.map = NULL;
+    map->size = 0;
+    map->version++;
+    mapThaw(map);
+    if(map->index != NULL && map->index->refs == 1)
+        memset(map->index->slots, 0, map->index->capacity * sizeof(*map->index->slots));
+    else
+    {
+        indexRelease(map->index);
+        map->index = NULL;
+    }
+    return MAP_SUCCESS;
+}
+
+int mapGetSize(Map map) { return !map ? -1 : map->size; }
+
+bool mapContains(Map map, MapKeyElement element)
+{
+    if( !map || !element)
+        return false;
+    if(map->hashKey != NULL)
+        return indexFindKey(map, element) >= 0;
+    if(map->frozen != NULL)
+        return frozenFind(map, element) != 0;
+    int index;
+    return findNode(map, element, &index) == NULL ? false : true;
+}
+
+// descends along the leftmost children of node, appending them to path
+static void pathDescendLeftmost(Path* path, Node node)
+{
+    while(true)
+    {
+        path->depth++;
+        path->nodes[path->depth] = node;
+        path->indices[path->depth] = 0;
+        if(node->isLeaf)
+            return;
+        node = node->children[0];
+    }
+}
+
+static void pathFirst(Map map, Path* path)
+{
+    path->depth = -1;
+    if(map->root != NULL)
+        pathDescendLeftmost(path, map->root);
+}
+
+// moves path to the in-order successor of its current element
+static void pathNext(Path* path)
+{
+    if(path->depth < 0)
+        return;
+
+    Node node = path->nodes[path->depth];
+    if(!node->isLeaf)
+    {
+        int child = ++path->indices[path->depth];
+        pathDescendLeftmost(path, node->children[child]);
+        return;
+    }
+    if(++path->indices[path->depth] < node->size)
+        return;
+    // leaf exhausted, climb until an ancestor still has an element after the child we came from
+    while(--path->depth >= 0)
+    {
+        if(path->indices[path->depth] < path->nodes[path->depth]->size)
+            return;
+    }
+}
+
+static MapKeyElement pathKey(Path* path)
+{
+    return path->depth < 0 ? NULL : path->nodes[path->depth]->keys[path->indices[path->depth]];
+}
+
+static MapDataElement pathData(Path* path)
+{
+    return path->depth < 0 ? NULL : path->nodes[path->depth]->data[path->indices[path->depth]];
+}
+
+
+MapKeyElement mapGetFirst(Map map)
+{
+    if( !map|| !map->root)
+        return NULL;
+
+    MapKeyElement key = mapCursorFirst(map, &map->iterator);
+    if(key == NULL)
+        return NULL;
+    STATS_ADD(map, iterationKeyCopies, 1);
+    return map->copyKey(key);
+}
+
+
+MapKeyElement mapGetNext(Map map)
+{
+    if( !map)
+        return NULL;
+
+    MapKeyElement key = mapCursorNext(&map->iterator);
+    if(key == NULL)
+        return NULL;
+    STATS_ADD(map, iterationKeyCopies, 1);
+    return map->copyKey(key);
+}
+
+// finds the key of the cursor again if elements of the map were moved since it was last used
+static void cursorSync(MapCursor* cursor)
+{
+    Map map = cursor->map;
+    if(cursor->version != map->version && cursor->path.depth >= 0)
+    {
+        pathSeek(map, cursor->key, &cursor->path);
+        cursor->key = pathKey(&cursor->path);
+    }
+    cursor->version = map->version;
+}
+
+// takes the key of the cursor's new position, ending the walk once it reaches the end of the cursor's range
+static MapKeyElement cursorSettle(MapCursor* cursor)
+{
+    cursor->key = pathKey(&cursor->path);
+    if(cursor->key != NULL && cursor->end != NULL && compareElements(cursor->map, cursor->key, cursor->end) >= 0)
+    {
+        cursor->path.depth = -1;
+        cursor->key = NULL;
+    }
+    return cursor->key;
+}
+
+static void cursorReset(Map map, MapCursor* cursor)
+{
+    cursor->map = map;
+    cursor->path.depth = -1;
+    cursor->key = NULL;
+    cursor->end = NULL;
+    cursor->version = map == NULL ? 0 : map->version;
+    cursor->removed = false;
+}
+
+MapKeyElement mapCursorFirst(Map map, MapCursor* cursor)
+{
+    if(!cursor)
+        return NULL;
+    cursorReset(map, cursor);
+    if(!map)
+        return NULL;
+
+    pathFirst(map, &cursor->path);
+    return cursorSettle(cursor);
+}
+
+MapKeyElement mapCursorNext(MapCursor* cursor)
+{
+    if(!cursor || !cursor->map || cursor->path.depth < 0)
+        return NULL;
+    cursorSync(cursor);
+    // after mapCursorRemove the cursor already stands on the successor
+    if(cursor->removed)
+        cursor->removed = false;
+    else
+        pathNext(&cursor->path);
+    return cursorSettle(cursor);
+}
+
+MapKeyElement mapCursorGetKey(MapCursor* cursor)
+{
+    return cursor == NULL || !cursor->map || cursor->path.depth < 0 || cursor->removed ? NULL : cursor->key;
+}
+
+MapDataElement mapCursorGetData(MapCursor* cursor)
+{
+    if(!cursor || !cursor->map || cursor->path.depth < 0 || cursor->removed)
+        return NULL;
+    cursorSync(cursor);
+    if(cursor->path.depth >= 0 && isShared(cursor->map))
+    {
+        // the data may be modified in place, so it must be private to the cursor's map
+        bool found;
+        if(findPrivatePath(cursor->map, cursor->key, &cursor->path, &found) != MAP_SUCCESS)
+            return NULL;
+        cursor->key = pathKey(&cursor->path);
+        cursor->version = cursor->map->version;
+    }
+    return pathData(&cursor->path);
+}
+
+MapResult mapCursorRemove(MapCursor* cursor)
+{
+    if(!cursor || !cursor->map)
+        return MAP_NULL_ARGUMENT;
+    if(cursor->path.depth < 0 || cursor->removed)
+        return MAP_ITEM_DOES_NOT_EXIST;
+
+    Map map = cursor->map;
+    cursorSync(cursor);
+    Path path = cursor->path;
+    if(isShared(map))
+    {
+        // the nodes on the cursor's path may be shared with a copy
+        bool found;
+        if(findPrivatePath(map, cursor->key, &path, &found) != MAP_SUCCESS)
+            return MAP_OUT_OF_MEMORY;
+    }
+    return removePath(map, &path, cursor);
+}
+
+// sets cursor to the first key not smaller than keyElement, or greater than it when after is set
+static MapKeyElement cursorSeek(Map map, MapKeyElement keyElement, MapCursor* cursor, bool after)
+{
+    cursorReset(map, cursor);
+    if(!map || !keyElement)
+        return NULL;
+
+    if(pathSeek(map, keyElement, &cursor->path) && after)
+        pathNext(&cursor->path);
+    return cursorSettle(cursor);
+}
+
+MapKeyElement mapLowerBound(Map map, MapKeyElement keyElement, MapCursor* cursor)
+{
+    MapCursor local;
+    return cursorSeek(map, keyElement, cursor == NULL ? &local : cursor, false);
+}
+
+MapKeyElement mapUpperBound(Map map, MapKeyElement keyElement, MapCursor* cursor)
+{
+    MapCursor local;
+    return cursorSeek(map, keyElement, cursor == NULL ? &local : cursor, true);
+}
+
+MapKeyElement mapCursorRange(Map map, MapCursor* cursor, MapKeyElement from, MapKeyElement to)
+{
+    if(!cursor)
+        return NULL;
+    if(from == NULL)
+        mapCursorFirst(map, cursor);
+    else
+        cursorSeek(map, from, cursor, false);
+    if(!map)
+        return NULL;
+    cursor->end = to;
+    return cursorSettle(cursor);
+}
+
+/** Note on splitting:
+ * All the leaves are at the same depth and every node but the root is at least half full, so the subtrees
+ * of one level hold numbers of elements within a small factor of each other. The keys of the top levels
+ * therefore cut the map into ranges of similar sizes, and mapSplit finds them walking a few nodes
+ * instead of counting the elements.
+ */
+typedef struct split_state_t {
+    MapKeyElement* bounds;
+    int parts;
+    int count;
+    int rank;
+    int emitted;
+} SplitState;
+
+// the number of keys in the levels of the subtree of node above depth
+static int splitCount(Node node, int depth)
+{
+    int count = node->size;
+    if(depth > 1 && !node->isLeaf)
+    {
+        for(int i = 0; i <= node->size; i++)
+            count += splitCount(node->children[i], depth - 1);
+    }
+    return count;
+}
+
+// walks the keys splitCount counted in order, keeping parts - 1 of them spread evenly over the count
+static void splitCollect(Node node, int depth, SplitState* state)
+{
+    for(int i = 0; i <= node->size && state->emitted < state->parts - 1; i++)
+    {
+        if(depth > 1 && !node->isLeaf)
+            splitCollect(node->children[i], depth - 1, state);
+        if(i == node->size)
+            break;
+        long target = (long) (state->emitted + 1) * (state->count + 1) / state->parts - 1;
+        if(state->rank++ == target)
+            state->bounds[state->emitted++] = node->keys[i];
+    }
+}
+
+int mapSplit(Map map, int parts, MapKeyElement* bounds)
+{
+    if(!map || !bounds || parts <= 1 || map->root == NULL)
+        return 0;
+
+    int depth = 1, count = splitCount(map->root, depth);
+    while(count < parts - 1 && count < map->size)
+        count = splitCount(map->root, ++depth);
+    SplitState state = { bounds, count < parts - 1 ? count + 1 : parts, count, 0, 0 };
+    splitCollect(map->root, depth, &state);
+    return state.emitted;
+}
+
+typedef struct map_worker_t {
+    Map map;
+    MapKeyElement from;
+    MapKeyElement to;
+    MapForEachFunction function;
+    void* accumulator;
+    pthread_t thread;
+    bool started;
+} Worker;
+
+// calls the worker's function on every pair in [from, to), a NULL bound leaves that end open
+static void* workerRun(void* argument)
+{
+    Worker* worker = argument;
+    Map map = worker->map;
+    Path path;
+    if(worker->from == NULL)
+        pathFirst(map, &path);
+    else
+        pathSeek(map, worker->from, &path);
+    for(; path.depth >= 0; pathNext(&path))
+    {
+        MapKeyElement key = pathKey(&path);
+        if(worker->to != NULL && compareElements(map, key, worker->to) >= 0)
+            break;
+        worker->function(key, pathData(&path), worker->accumulator);
+    }
+    return NULL;
+}
+
+MapResult mapParallelForEach(Map map, int threads, MapForEachFunction function, void** accumulators)
+{
+    if(!map || !function)
+        return MAP_NULL_ARGUMENT;
+    if(threads < 1)
+        threads = 1;
+
+    MapKeyElement* bounds = malloc(threads * sizeof(*bounds));
+    Worker* workers = malloc(threads * sizeof(*workers));
+    if(bounds == NULL || workers == NULL)
+    {
+        free(bounds);
+        free(workers);
+        return MAP_OUT_OF_MEMORY;
+    }
+    int ranges = mapSplit(map, threads, bounds) + 1;
+    for(int i = 0; i < ranges; i++)
+    {
+        workers[i].map = map;
+        workers[i].from = i == 0 ? NULL : bounds[i - 1];
+        workers[i].to = i == ranges - 1 ? NULL : bounds[i];
+        workers[i].function = function;
+        workers[i].accumulator = accumulators == NULL ? NULL : accumulators[i];
+        workers[i].started = false;
+    }
+
+    // the counters are not shared between threads, the walk is not counted
+    MapStats* stats = map->stats;
+    map->stats = NULL;
+    for(int i = 1; i < ranges; i++)
+        workers[i].started = pthread_create(&workers[i].thread, NULL, workerRun, &workers[i]) == 0;
+    // the calling thread takes the first range, and any range a thread could not be started for
+    for(int i = 0; i < ranges; i++)
+    {
+        if(!workers[i].started)
+            workerRun(&workers[i]);
+    }
+    for(int i = 1; i < ranges; i++)
+    {
+        if(workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+    }
+    map->stats = stats;
+
+    free(bounds);
+    free(workers);
+    return MAP_SUCCESS;
+}
+
+MapResult mapSetStatsEnabled(Map map, bool enabled)
+{
+    if(map == NULL)
+        return MAP_NULL_ARGUMENT;
+
+    free(map->stats);
+    map->stats = NULL;
+    if(!enabled)
+        return MAP_SUCCESS;
+    map->stats = calloc(1, sizeof(*map->stats));
+    if(map->stats == NULL)
+        return MAP_OUT_OF_MEMORY;
+    map->stats->peakSize = map->size;
+    return MAP_SUCCESS;
+}
+
+MapResult mapGetStats(Map map, MapStats* stats)
+{
+    if(map == NULL || stats == NULL)
+        return MAP_NULL_ARGUMENT;
+    if(map->stats == NULL)
+        return MAP_ERROR;
+    *stats = *map->stats;
+    return MAP_SUCCESS;
+}
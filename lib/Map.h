@@ -15,23 +15,60 @@
 * @brief Generic Map Container
 *
 * Implements a map container type.
+* The map is kept sorted by the key compare function as a balanced tree (B-tree), so mapContains,
+* mapGet, mapPut and mapRemove cost O(log n) key comparisons and iteration visits the keys in increasing order.
+* mapCopy is O(1): the copy shares the tree with the original, and whichever of them is modified later
+* copies only the nodes on the path it changes (copy on write).
 * The map has an internal iterator for external use.
 * For all functions where the state of the iterator after calling that function is not stated,
 * you should assume that the state of the iterator is undefined.
 *
 * The following functions are available:
 *   mapCreate() - Creates a new empty map
+*   mapCreateHashed() - Creates a new empty map that also keeps a hash index for O(1) mapGet and mapContains
+*   mapCreateFromSorted() - Creates a new map of given pairs sorted by key in linear time
+*   mapMerge() - Creates a new map of the keys of two maps, in linear time.
+*   mapIntersect() - Creates a new map of the keys two maps have in common, in linear time.
+*   mapDifference() - Creates a new map of the keys of one map that are missing in another, in linear time.
 *   mapDestroy() - Deletes an existing map and frees all resources
-*   mapCopy() - Copies an existing map
+*   mapCopy() - Copies an existing map in O(1), the copies share their nodes until they are modified
 *   mapGetSize() - Returns the size of a given map
 *   mapContains() - Checks if a key exists inside the map. This resets the internal iterator.
 *   mapPut() - Gives a specific key a given value. If the key exists, the value is overridden. This resets the internal iterator.
+*   mapPutTake() - Like mapPut, but the map takes ownership of the given value instead of copying it.
+*   mapPutBatch() - Puts many pairs at once, merging them with the map in linear time.
 *   mapGet() - Returns the data paired to a key which matches the given key. Iterator status unchanged
-*   mapRemove() - Removes a pair of (key,data) elements for which the key matches a given element (by the key compare function). This resets the internal iterator.
+*   mapPeek() - Like mapGet, but for reading only: it never changes the map, so threads may call it at the same time.
+*   mapGetMany() - Returns the data of many keys at once, overlapping the memory accesses of their searches.
+*   mapGetOrPut() - Returns the data paired to a key, inserting a copy of a given data first if the key is missing.
+*   mapEntryFind() - Searches a key once and remembers where it is (or where it belongs) for the other entry functions.
+*   mapEntryGet() - Returns the data of an entry.
+*   mapEntryInsert() - Fills an entry that was not found without searching the map again.
+*   mapEntryInsertTake() - Like mapEntryInsert, but the map takes ownership of the given value instead of copying it.
+*   mapEntrySet() - Replaces the data of a found entry without searching the map again.
+*   mapEntryRemove() - Removes the pair of a found entry without searching the map again.
+*   mapRemove() - Removes a pair of (key,data) elements for which the key matches a given element (by the key compare function). This resets the internal iterator,
+*                 unless it removes the key the iterator is at.
 *   mapGetFirst() - Sets the internal iterator to the first (smallest) key in the map, and returns a copy of it.
 *   mapGetNext() - Advances the internal iterator to the next key and returns a copy of it.
 *   mapClear() - Clears the contents of the map. Frees all the elements of the map using the free function.
 *   MAP_FOREACH - A macro for iterating over the map's elements. The iterator needs to be deallocated (freed) after each iteration.
+*   mapCursorFirst() - Sets an external cursor to the smallest key element in the map and returns it without copying it.
+*   mapCursorNext() - Advances an external cursor to the next key element and returns it without copying it.
+*   mapCursorGetKey() - Returns the key element a cursor points at.
+*   mapCursorGetData() - Returns the data element a cursor points at.
+*   mapCursorRemove() - Removes the pair a cursor points at, the cursor goes on with the next key.
+*   MAP_FOREACH_CURSOR - A macro for iterating over the map's elements with an external cursor. Nothing needs to be freed.
+*   mapLowerBound() - Returns the smallest key not smaller than a given key, and can set a cursor to it.
+*   mapUpperBound() - Returns the smallest key greater than a given key, and can set a cursor to it.
+*   mapCursorRange() - Sets an external cursor to walk only the keys in a given range [from, to).
+*   MAP_FOREACH_RANGE - A macro for iterating over the map's elements whose keys are in a given range.
+*   mapSplit() - Finds keys that cut a map into a given number of ranges of similar sizes.
+*   mapParallelForEach() - Calls a read-only function on every pair of a map, on several threads.
+*   mapFreeze() - Lays a map that is no longer modified out for faster mapGet and mapContains, until it is modified again.
+*   mapIsFrozen() - Checks whether a map is frozen.
+*   mapSetStatsEnabled() - Starts or stops counting the work a map does, see MapStats.
+*   mapGetStats() - Returns the counters of a map that counts its work.
  */
 
 
@@ -54,7 +91,76 @@ typedef enum MapResult_t {
 typedef void *MapDataElement;
 typedef void *MapKeyElement;
 
+/** The maximal depth of the map's tree, enough for any map with an int size. */
+#define MAP_MAX_DEPTH 32
+
+/** Asks the processor to start loading the memory at address, where the compiler can do it. Never faults. */
+#ifdef __GNUC__
+#define MAP_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define MAP_PREFETCH(address) ((void) 0)
+#endif
+
+/**
+ * A position inside the map's tree. Private to the map, declared here only so entries
+ * can be kept on the stack.
+ */
+typedef struct MapPath_t {
+    struct node_t* nodes[MAP_MAX_DEPTH];
+    int indices[MAP_MAX_DEPTH];
+    int depth;
+} MapPath;
+
+/**
+ * The result of a single search for a key, see mapEntryFind.
+ * An entry is valid until the map is modified or copied by anything but the entry functions called on it,
+ * mapEntryInsert, mapEntrySet and mapEntryRemove return MAP_ERROR for an entry the map moved away from.
+ */
+typedef struct MapEntry_t {
+    Map map;
+    MapPath path;
+    MapDataElement data;
+    unsigned int version;
+    bool found;
+} MapEntry;
+
+/**
+ * An external iterator over a map, see mapCursorFirst.
+ * Any number of cursors can walk the same map at the same time, independently of each other
+ * and of the internal iterator. A cursor stays valid while other keys are inserted into or removed
+ * from the map, it finds its key again when the map's nodes moved. The key the cursor points at
+ * is removed with mapCursorRemove; removing it otherwise, clearing the map, or destroying or modifying
+ * copies the map shares nodes with while the cursor is used invalidates it.
+ */
+typedef struct MapCursor_t {
+    Map map;
+    MapPath path;
+    MapKeyElement key;
+    MapKeyElement end;
+    unsigned int version;
+    bool removed;
+} MapCursor;
+
+/**
+ * Counters of the work a map did since mapSetStatsEnabled turned them on, see mapGetStats.
+ * Dividing nodesVisited by searches gives the average number of nodes a search of the tree visits,
+ * and indexProbes by indexLookups the average length of a probe in the hash index.
+ */
+typedef struct MapStats_t {
+    long searches; /**< Searches of the tree for a key */
+    long nodesVisited; /**< Nodes those searches visited */
+    long indexLookups; /**< Searches of the hash index for a key */
+    long indexProbes; /**< Slots of the hash index those searches inspected */
+    long compareCalls; /**< Calls of the key compare function */
+    long allocations; /**< Tree nodes and hash indexes allocated */
+    long elementCopies; /**< Calls of the copy functions made to store keys and data */
+    long iterationKeyCopies; /**< Copies of keys returned by mapGetFirst and mapGetNext */
+    int peakSize; /**< The largest size the map reached */
+} MapStats;
+
 typedef MapDataElement(*copyMapDataElements)(MapDataElement);
+/** Type of function mapParallelForEach calls on every pair, with the accumulator of the calling thread. */
+typedef void(*MapForEachFunction)(MapKeyElement, MapDataElement, void*);
 typedef MapKeyElement(*copyMapKeyElements)(MapKeyElement);
 typedef void(*freeMapDataElements)(MapDataElement);
 typedef void(*freeMapKeyElements)(MapKeyElement);
@@ -69,6 +175,12 @@ typedef void(*freeMapKeyElements)(MapKeyElement);
  */
 typedef int(*compareMapKeyElements)(MapKeyElement , MapKeyElement);
 
+/**
+ * @brief Type of function used by a hashed map to hash key elements.
+ * Keys which are equal by the compare function must have the same hash.
+ */
+typedef unsigned int(*hashMapKeyElements)(MapKeyElement);
+
 /**
  * @brief Allocates a new empty map.
  *
@@ -85,6 +197,65 @@ Map mapCreate(copyMapDataElements copyDataElement,
               freeMapKeyElements freeKeyElement,
               compareMapKeyElements compareKeyElements);
 
+/**
+ * @brief Allocates a new empty map which keeps, next to the ordered tree, an open addressing hash index of its keys.
+ * mapGet and mapContains are answered from the index in O(1) expected time, iteration still follows compareKeyElements.
+ * mapPut and mapRemove keep both structures up to date.
+ *
+ * @param hashKeyElement Function pointer to be used for hashing key elements. Equal keys must have equal hashes.
+ * The other parameters are the same as in mapCreate.
+ * @return A new Map in case of success, NULL if one of the parameters is NULL or allocations failed.
+ */
+Map mapCreateHashed(copyMapDataElements copyDataElement,
+                    copyMapKeyElements copyKeyElement,
+                    freeMapDataElements freeDataElement,
+                    freeMapKeyElements freeKeyElement,
+                    compareMapKeyElements compareKeyElements,
+                    hashMapKeyElements hashKeyElement);
+
+/**
+ * @brief Allocates a new map holding copies of the size given pairs, building its tree in O(size)
+ * instead of searching for every key. keys are expected sorted by compareKeyElements; unsorted keys
+ * are sorted first and of equal keys the last pair is kept, as mapPut would.
+ *
+ * @param keys The key elements of the pairs.
+ * @param values The data elements of the pairs, values[i] belongs to keys[i].
+ * @param size The number of pairs.
+ * The other parameters are the same as in mapCreate.
+ * @return A new Map in case of success, NULL if a NULL was sent or allocations failed.
+ */
+Map mapCreateFromSorted(copyMapDataElements copyDataElement,
+                        copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement,
+                        freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        MapKeyElement* keys,
+                        MapDataElement* values,
+                        int size);
+
+/**
+ * @brief Allocates a new map holding copies of the pairs of both maps. For a key that is in both maps
+ * the data of second is taken, as putting all the pairs of second into a copy of first would.
+ * Both maps are walked in order side by side, so this costs O(n + m) key comparisons instead of a search per key.
+ * The new map gets the functions (and hash index) of first. Both maps must hold the same types and be
+ * ordered by equivalent compare functions. Iterator status unchanged for both maps.
+ *
+ * @param first The map whose functions the new map gets.
+ * @param second The other map.
+ * @return A new Map in case of success, NULL if a NULL was sent or allocations failed.
+ */
+Map mapMerge(Map first, Map second);
+
+/**
+ * @brief Same as mapMerge, but the new map holds copies of only the pairs of first whose keys are also in second.
+ */
+Map mapIntersect(Map first, Map second);
+
+/**
+ * @brief Same as mapMerge, but the new map holds copies of only the pairs of first whose keys are not in second.
+ */
+Map mapDifference(Map first, Map second);
+
 /**
  * @brief Deallocates an existing map.
  */
@@ -92,7 +263,10 @@ void mapDestroy(Map map);
 
 
 /**
- * @brief Creates a copy of target map.
+ * @brief Creates a copy of target map in O(1).
+ * The copy shares the nodes of map instead of copying them. The elements of a shared node are copied
+ * with the copy functions only when one of the maps modifies that node or hands out its data,
+ * so each modification copies at most the nodes on the path from the root to the element.
  * Iterator values for both maps is undefined after this operation.
  *
  * @return
@@ -131,27 +305,172 @@ bool mapContains(Map map, MapKeyElement element);
  */
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
 
+/**
+ * @brief Gives a specified key a specific value, which the map takes ownership of instead of copying it.
+ * On success the value will be freed by the map's free function, the caller must not free it.
+ * On failure the caller still owns it. Iterator's value is undefined after this operation.
+ *
+ * @param map The map for which to reassign the data element.
+ * @param keyElement The key element which needs to be reassigned. A copy of it is inserted.
+ * @param dataElement The new data element to associate with the given key.
+ * @return
+ *  - MAP_SUCCESS if the paired elements had been inserted successfully,
+ *  - MAP_NULL_ARGUMENT if a NULL was sent as map or keyElement or dataElement,
+ *  - MAP_OUT_OF_MEMORY if an allocation failed.
+ */
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+ * @brief Puts copies of size pairs into the map, as if mapPut was called for each of them in order.
+ * A batch that is not small compared to the map is sorted if needed (O(size log size), skipped for
+ * sorted keys) and merged with the map in O(mapGetSize + size); a small one is put pair by pair.
+ * Iterator's value is undefined after this operation.
+ *
+ * @param keys The key elements of the pairs.
+ * @param values The data elements of the pairs, values[i] belongs to keys[i].
+ * @param size The number of pairs.
+ * @return
+ *  - MAP_SUCCESS if all the pairs had been put successfully,
+ *  - MAP_NULL_ARGUMENT if a NULL was sent as map, keys or values or one of their elements,
+ *  - MAP_OUT_OF_MEMORY if an allocation failed. A merged batch leaves the map unchanged,
+ *    a small batch may have been put in part.
+ */
+MapResult mapPutBatch(Map map, MapKeyElement* keys, MapDataElement* values, int size);
+
 /**
  * @brief Returns the data associated with a specific key in the map. Iterator status unchanged.
+ * The data may be modified in place, so on a map that shares nodes with a copy the path to it is copied first.
  *
  * @param map The map from which to get the data element.
  * @param keyElement The key element which needs to be found and whose data we want to get.
  * @return
  *  - The data element associated with the key
- *  - NULL if a NULL pointer was sent or if the map does not contain the requested key.
+ *  - NULL if a NULL pointer was sent, if the map does not contain the requested key or if copying its path failed.
  */
 MapDataElement mapGet(Map map, MapKeyElement keyElement);
 
 /**
- * @brief Removes a pair of key and data elements from the map.
+ * @brief Returns the data associated with a specific key in the map, for reading only. Iterator status unchanged.
+ * Unlike mapGet, the path to the data is never copied, so the map is not changed at all and any number
+ * of threads may peek into a map at the same time, as long as no thread modifies it or its copies meanwhile
+ * and it does not count its work (see mapSetStatsEnabled). The data may be shared with copies of the map
+ * and must not be modified.
+ *
+ * @param map The map from which to get the data element.
+ * @param keyElement The key element which needs to be found and whose data we want to get.
+ * @return
+ *  - The data element associated with the key
+ *  - NULL if a NULL pointer was sent or if the map does not contain the requested key.
+ */
+MapDataElement mapPeek(Map map, MapKeyElement keyElement);
+
+/**
+ * @brief Looks count keys up at once. The searches run interleaved, every one requesting the next node it
+ * needs before the others go on, so the cache misses of independent keys overlap instead of adding up.
+ * Faster than count calls of mapGet when the map does not fit in the cache. Iterator status unchanged.
+ *
+ * @param map The map to search in.
+ * @param keys The key elements to look up, a NULL key is treated as missing.
+ * @param count The number of keys.
+ * @param out Receives, for every key, the data element paired with it (as mapGet returns it) or NULL if it is missing.
+ * @return
+ *  - MAP_NULL_ARGUMENT if map, keys or out is NULL.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapGetMany(Map map, MapKeyElement* keys, int count, MapDataElement* out);
+
+/**
+ * @brief Returns the data associated with a key, after inserting a copy of dataElement for it if the key is missing.
+ * The key is searched only once. Iterator's value is undefined after this operation.
+ *
+ * @return
+ *  - The data element that is in the map for the key after the call. It stays valid until the key is removed or overridden.
+ *  - NULL if a NULL was sent or an allocation failed.
+ */
+MapDataElement mapGetOrPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+ * @brief Searches for a key and records the result in entry, so the key can be read, inserted or
+ * overridden afterwards without searching the map again. Iterator status unchanged.
+ * If an allocation fails while the path is copied off a shared map, false is returned and
+ * mapEntryInsert returns MAP_OUT_OF_MEMORY.
+ *
+ * @param map The map to search in.
+ * @param keyElement The key element to look for.
+ * @param entry The entry to fill.
+ * @return
+ *  - true if the key element was found in the map
+ *  - false if it was not found, or if a NULL was sent.
+ */
+bool mapEntryFind(Map map, MapKeyElement keyElement, MapEntry* entry);
+
+/**
+ * @brief Returns the data of an entry that was found or inserted.
+ * @return
+ *  - The data element of the entry, it can be modified in place.
+ *  - NULL if a NULL was sent or the entry is empty.
+ */
+MapDataElement mapEntryGet(MapEntry* entry);
+
+/**
+ * @brief Inserts copies of keyElement and dataElement at the position of an entry that was not found.
+ * keyElement must be equal to the key that was searched. Afterwards only mapEntryGet may be used on the entry.
  * Iterator's value is undefined after this operation.
  *
+ * @return
+ *  - MAP_SUCCESS if the paired elements had been inserted successfully
+ *  - MAP_NULL_ARGUMENT if a NULL was sent
+ *  - MAP_ITEM_ALREADY_EXISTS if the entry was found
+ *  - MAP_ERROR if the map was modified since the entry was found
+ *  - MAP_OUT_OF_MEMORY if an allocation failed.
+ */
+MapResult mapEntryInsert(MapEntry* entry, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+ * @brief Same as mapEntryInsert, but the map takes ownership of dataElement instead of copying it.
+ * On failure the caller still owns dataElement.
+ */
+MapResult mapEntryInsertTake(MapEntry* entry, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+ * @brief Replaces the data of a found entry with a copy of dataElement. Iterator status unchanged.
+ *
+ * @return
+ *  - MAP_SUCCESS if the data element had been replaced successfully
+ *  - MAP_NULL_ARGUMENT if a NULL was sent
+ *  - MAP_ITEM_DOES_NOT_EXIST if the entry was not found
+ *  - MAP_ERROR if the entry was filled by mapEntryInsert or the map was modified since it was found
+ *  - MAP_OUT_OF_MEMORY if an allocation failed.
+ */
+MapResult mapEntrySet(MapEntry* entry, MapDataElement dataElement);
+
+/**
+ * @brief Removes the pair of key and data elements of a found entry, using the position recorded by
+ * mapEntryFind instead of searching for the key again. The entry is not found afterwards.
+ * Iterator's value is undefined after this operation, as after mapRemove.
+ *
+ * @param entry The entry to remove.
+ * @return
+ *  - MAP_NULL_ARGUMENT if a NULL was sent.
+ *  - MAP_ITEM_DOES_NOT_EXIST if the entry was not found.
+ *  - MAP_ERROR if the map was modified since the entry was found.
+ *  - MAP_OUT_OF_MEMORY if the nodes the map shares with a copy could not be copied, the map is unchanged.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapEntryRemove(MapEntry* entry);
+
+/**
+ * @brief Removes a pair of key and data elements from the map.
+ * Iterator's value is undefined after this operation, unless the removed key is the one the iterator
+ * is at: then mapGetNext goes on with the key after it, so the current key may be removed inside MAP_FOREACH.
+ *
  * @param map The map to remove the elements from.
  * @param keyElement The key element to find and remove from the map.
  * @return
  *  - MAP_SUCCESS if the paired elements had been removed successfully
  *  - MAP_NULL_ARGUMENT if a NULL was sent to the function
- *  - MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exist in the map.
+ *  - MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exist in the map
+ *  - MAP_OUT_OF_MEMORY if the nodes the map shares with a copy could not be copied, the map is unchanged.
  */
 MapResult mapRemove(Map map, MapKeyElement keyElement);
 
@@ -194,5 +513,198 @@ MapResult mapClear(Map map);
         iterator ;\
         iterator = mapGetNext(map))
 
+/**
+ * @brief Sets cursor to the smallest key element in the map. Iterator status unchanged.
+ *
+ * @param map The map to iterate over.
+ * @param cursor The cursor to set, usually a local variable.
+ * @return
+ *  - The first key element of the map. It is not a copy and must not be freed or modified.
+ *  - NULL if a NULL pointer was sent or the map is empty.
+ */
+MapKeyElement mapCursorFirst(Map map, MapCursor* cursor);
+
+/**
+ * @brief Advances cursor to the next key element. Iterator status unchanged.
+ *
+ * @return
+ *  - The next key element of the map. It is not a copy and must not be freed or modified.
+ *  - NULL if the end of the map was reached or a NULL pointer was sent.
+ */
+MapKeyElement mapCursorNext(MapCursor* cursor);
+
+/**
+ * @brief Returns the key element cursor points at, NULL if cursor is past the end or NULL. The key is not a copy.
+ */
+MapKeyElement mapCursorGetKey(MapCursor* cursor);
+
+/**
+ * @brief Returns the data element cursor points at, NULL if cursor is past the end or NULL.
+ * Saves the mapGet that usually follows every step of an iteration. Like mapGet, it copies the path
+ * to the data off nodes shared with a copy of the map, and returns NULL if that fails.
+ */
+MapDataElement mapCursorGetData(MapCursor* cursor);
+
+/**
+ * @brief Removes the pair of key and data elements a cursor points at without searching for the key.
+ * Afterwards the cursor points at no key, and mapCursorNext returns the key that followed the removed one,
+ * so the current key may be removed inside MAP_FOREACH_CURSOR. The iterator of the loop must not be used
+ * after its key was removed. Other cursors standing on the removed key are invalidated.
+ *
+ * @param cursor The cursor pointing at the pair to remove.
+ * @return
+ *  - MAP_NULL_ARGUMENT if a NULL was sent.
+ *  - MAP_ITEM_DOES_NOT_EXIST if the cursor points at no key.
+ *  - MAP_OUT_OF_MEMORY if the nodes the map shares with a copy could not be copied, the map is unchanged.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapCursorRemove(MapCursor* cursor);
+
+/**
+ * @brief Macro for iterating over a map with an external cursor. Declares the cursor and the iterator for the loop.
+ * The iterator is borrowed from the map and must not be freed. Loops may be nested over the same map.
+ */
+#define MAP_FOREACH_CURSOR(type, iterator, cursor, map) \
+    for(MapCursor cursor, *cursor##Once = &cursor; cursor##Once; cursor##Once = NULL) \
+        for(type iterator = (type) mapCursorFirst(map, &cursor) ; \
+            iterator ;\
+            iterator = (type) mapCursorNext(&cursor))
+
+/**
+ * @brief Finds the smallest key element that is not smaller than keyElement, in O(log n).
+ * Iterator status unchanged.
+ *
+ * @param map The map to search in.
+ * @param keyElement The key element to compare with.
+ * @param cursor If not NULL, set to the key that was found so mapCursorNext continues from it.
+ * @return
+ *  - The key element found. It is not a copy and must not be freed or modified.
+ *  - NULL if a NULL pointer was sent or all the keys of the map are smaller than keyElement.
+ */
+MapKeyElement mapLowerBound(Map map, MapKeyElement keyElement, MapCursor* cursor);
+
+/**
+ * @brief Same as mapLowerBound, but finds the smallest key element that is greater than keyElement.
+ */
+MapKeyElement mapUpperBound(Map map, MapKeyElement keyElement, MapCursor* cursor);
+
+/**
+ * @brief Sets cursor to the smallest key element in the range [from, to), and bounds its walk by to,
+ * so mapCursorNext returns NULL once the keys reach to. Finding the start costs O(log n) and every step after it O(1) on average.
+ * Iterator status unchanged.
+ *
+ * @param map The map to iterate over.
+ * @param cursor The cursor to set.
+ * @param from The smallest key of the range, NULL to start from the first key of the map.
+ * @param to The key the range ends before, NULL to go on to the end of the map. It is not copied
+ * and must stay valid while the cursor is used.
+ * @return
+ *  - The first key element of the range. It is not a copy and must not be freed or modified.
+ *  - NULL if map or cursor is NULL or the range is empty.
+ */
+MapKeyElement mapCursorRange(Map map, MapCursor* cursor, MapKeyElement from, MapKeyElement to);
+
+/**
+ * @brief Macro for iterating over the keys of a map in the range [from, to) with an external cursor,
+ * from and to may be NULL for an open end. Declares the cursor and the iterator for the loop, like MAP_FOREACH_CURSOR.
+ */
+#define MAP_FOREACH_RANGE(type, iterator, cursor, map, from, to) \
+    for(MapCursor cursor, *cursor##Once = &cursor; cursor##Once; cursor##Once = NULL) \
+        for(type iterator = (type) mapCursorRange(map, &cursor, from, to) ; \
+            iterator ;\
+            iterator = (type) mapCursorNext(&cursor))
+
+/**
+ * @brief Finds up to parts - 1 keys that cut the map into parts contiguous ranges of similar sizes:
+ * [first key, bounds[0]), [bounds[0], bounds[1]), ..., [bounds[count - 1], past the last key].
+ * The ranges fit mapCursorRange. The keys are taken from the top levels of the tree, so this costs
+ * O(parts) and the sizes of the ranges are equal only up to a small factor. Iterator status unchanged.
+ *
+ * @param map The map to split.
+ * @param parts The number of ranges wanted.
+ * @param bounds Receives the keys in increasing order, room for parts - 1 keys is needed. They are not copies
+ * and must not be freed or modified.
+ * @return The number of keys put in bounds; fewer than parts - 1 if the map is too small,
+ * 0 if a NULL was sent, parts is smaller than 2 or the map is empty.
+ */
+int mapSplit(Map map, int parts, MapKeyElement* bounds);
+
+/**
+ * @brief Calls function on every pair of the map, splitting the map (see mapSplit) into up to threads ranges
+ * that are walked at the same time, each by its own thread. The calling thread walks one of the ranges.
+ * The pairs of one range are visited in increasing key order, the ranges in no particular order.
+ * Every thread passes its own accumulator to function, so results can be summed up without locks and be
+ * combined by the caller afterwards. Work done here is not counted by mapGetStats. Iterator status unchanged.
+ *
+ * Thread safety: function runs on several threads at the same time. Neither the map nor its copies may be
+ * modified while it runs, and function must not modify them either. function may read this map or any other
+ * map that no thread modifies meanwhile only with functions that do not change it: mapPeek, mapContains and
+ * mapGetSize, on maps that do not count their work. mapGet, mapGetMany, the entry functions and the internal
+ * iterator are not allowed there, since on a map shared with a copy they copy nodes (see mapCopy).
+ *
+ * @param map The map to walk.
+ * @param threads The number of threads to use, at least one.
+ * @param function The function to call with every key, its data and the accumulator of the thread.
+ * @param accumulators An array of threads accumulators, accumulators[i] goes to the i-th range.
+ * May be NULL, then function gets NULL.
+ * @return
+ *  - MAP_NULL_ARGUMENT if map or function is NULL.
+ *  - MAP_OUT_OF_MEMORY if an allocation failed, then function was not called.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapParallelForEach(Map map, int threads, MapForEachFunction function, void** accumulators);
+
+/**
+ * @brief Freezes a map that is read much more than it is modified: its pairs are laid out in one sorted
+ * array (in Eytzinger order), which mapGet and mapContains search instead of the tree with fewer cache misses.
+ * The map stays an ordinary map otherwise. Any modification (putting, removing, clearing, or handing out
+ * data of nodes shared with a copy) drops the layout, and the map has to be frozen again to get it back.
+ * Searches of the array are about twice as fast while the map fits in the cache (up to tens of thousands of pairs);
+ * for larger maps the keys themselves, which both layouts reach through pointers, dominate and freezing
+ * does not help. A map with a hash index gains nothing from freezing, its index is still used first.
+ * Iterator status unchanged.
+ * Freezing costs O(n) time and an array of n pairs of pointers.
+ *
+ * @param map The map to freeze.
+ * @return
+ *  - MAP_NULL_ARGUMENT if a NULL pointer was sent.
+ *  - MAP_OUT_OF_MEMORY if the array could not be allocated, the map is unchanged.
+ *  - MAP_SUCCESS otherwise, also if the map is already frozen.
+ */
+MapResult mapFreeze(Map map);
+
+/**
+ * @brief Checks whether a map is frozen, see mapFreeze.
+ *
+ * @return true if map is not NULL and was frozen and not modified since, false otherwise.
+ */
+bool mapIsFrozen(Map map);
+
+/**
+ * @brief Starts or stops counting the work done by a map. Starting resets all counters to zero and
+ * peakSize to the current size. A map does not count by default, and a copy does not count even if
+ * the map it was copied from does. Counting adds a test per counted event and nothing when stopped.
+ *
+ * @param map The map to count the work of.
+ * @param enabled true to start counting, false to stop.
+ * @return
+ *  - MAP_NULL_ARGUMENT if a NULL pointer was sent.
+ *  - MAP_OUT_OF_MEMORY if an allocation failed, the map does not count then.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapSetStatsEnabled(Map map, bool enabled);
+
+/**
+ * @brief Copies the counters of a map into stats. Iterator status unchanged.
+ *
+ * @param map The map to get the counters of.
+ * @param stats Where to copy the counters.
+ * @return
+ *  - MAP_NULL_ARGUMENT if a NULL pointer was sent.
+ *  - MAP_ERROR if the map does not count its work.
+ *  - MAP_SUCCESS otherwise.
+ */
+MapResult mapGetStats(Map map, MapStats* stats);
+
 #endif /* Map_h */
 
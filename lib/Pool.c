@@ -0,0 +1,83 @@
+#include "Pool.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/** Note:
+ * A slab starts with a pointer to the next slab, the objects follow it. Every object is rounded up
+ * to a multiple of the pointer size, so it is aligned for pointers, ints and doubles and a free object
+ * can hold the link of the free list in its first word.
+ */
+typedef union slab_header_t {
+    void* next;
+    double alignment;
+} SlabHeader;
+
+static size_t slotSize(Pool* pool)
+{
+    size_t word = sizeof(SlabHeader);
+    return (pool->objectSize + word - 1) / word * word;
+}
+
+static bool addSlab(Pool* pool)
+{
+    size_t size = slotSize(pool);
+    SlabHeader* slab = malloc(sizeof(SlabHeader) + size * pool->objectsPerSlab);
+    if(slab == NULL)
+        return false;
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->nextFree = (char*) (slab + 1);
+    pool->slabEnd = pool->nextFree + size * pool->objectsPerSlab;
+    return true;
+}
+
+// frees all the slabs but the newest, which is emptied and kept, so a pool that empties and fills up again
+// over and over, as a loop building small maps does, does not malloc and free a slab every time
+static void releaseSpareSlabs(Pool* pool)
+{
+    SlabHeader* kept = pool->slabs;
+    while(kept->next != NULL)
+    {
+        SlabHeader* slab = kept->next;
+        kept->next = slab->next;
+        free(slab);
+    }
+    pool->freeList = NULL;
+    pool->nextFree = (char*) (kept + 1);
+}
+
+void* poolAlloc(Pool* pool)
+{
+    if(pool == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    void* object = pool->freeList;
+    if(object != NULL)
+        pool->freeList = *(void**) object;
+    else if(pool->nextFree != pool->slabEnd || addSlab(pool))
+    {
+        object = pool->nextFree;
+        pool->nextFree += slotSize(pool);
+    }
+    if(object != NULL)
+        pool->liveObjects++;
+    pthread_mutex_unlock(&pool->lock);
+    return object;
+}
+
+void poolFree(Pool* pool, void* object)
+{
+    if(pool == NULL || object == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    assert(pool->liveObjects > 0);
+    *(void**) object = pool->freeList;
+    pool->freeList = object;
+    if(--pool->liveObjects == 0)
+        releaseSpareSlabs(pool);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,54 @@
+#ifndef Pool_h
+#define Pool_h
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+* @file Pool.h
+* @brief Fixed size object pool
+*
+* A pool hands out objects of a single size, carved from slabs of many objects, and keeps the objects
+* that were given back on a free list for reuse. Allocating from a warm pool costs no malloc at all
+* and objects of the same kind end up next to each other in memory.
+* Once the last object is given back all the slabs but one are released; the one kept, emptied, serves the
+* next objects, so a pool that empties again and again costs no malloc either.
+* Pools are meant to be static variables shared by every container of the same kind. Every pool has a lock
+* that poolAlloc and poolFree hold, so containers used by different threads may share a pool. The lock is
+* most of what they cost: uncontended, a poolAlloc and poolFree pair costs about as much as a malloc and free
+* of a small object, and threads allocating from the same pool at the same time wait for each other.
+*
+* The following functions are available:
+*   POOL_INITIALIZER - Initializes a static pool for objects of a given type.
+*   poolAlloc() - Takes an object from the pool.
+*   poolFree() - Gives an object back to the pool.
+*/
+
+typedef struct Pool_t {
+    size_t objectSize;
+    int objectsPerSlab;
+    void* freeList;
+    void* slabs;
+    char* nextFree;
+    char* slabEnd;
+    long liveObjects;
+    pthread_mutex_t lock;
+} Pool;
+
+/**
+ * @brief Initializer for a pool of objects of the given type, taken from the system perSlab objects at a time.
+ */
+#define POOL_INITIALIZER(type, perSlab) { sizeof(type), (perSlab), NULL, NULL, NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER }
+
+/**
+ * @brief Takes an uninitialized object from the pool.
+ * @return The object, or NULL if a NULL was sent or a new slab could not be allocated.
+ */
+void* poolAlloc(Pool* pool);
+
+/**
+ * @brief Gives an object taken by poolAlloc back to the same pool. A NULL object is ignored.
+ */
+void poolFree(Pool* pool, void* object);
+
+#endif /* Pool_h */
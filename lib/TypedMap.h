@@ -0,0 +1,522 @@
+//
+// Created by Baraa Egbaria.
+// Copyright © 2022 Baraa Egbaria All rights reserved.
+//
+// TypedMap.h
+//
+
+#ifndef TypedMap_h
+#define TypedMap_h
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Map.h"
+#include "Pool.h"
+
+/**
+* @file TypedMap.h
+* @brief Type specialized map family
+*
+* MAP_DEFINE generates a map type and its functions for one key type and one value type, the same
+* B-tree Map is, without the void pointers. Keys are stored by value inside the nodes and compared
+* with <, so searches compile to inlined comparisons instead of a compareKeys call through a pointer
+* and a pointer chase to every key, and no key is ever allocated.
+* Values must be pointer types (ADTs). The map owns them and releases them with the destroy function
+* given to MAP_DEFINE; NULL is never stored, so the functions returning a value return NULL for a missing key.
+* Iteration goes by increasing key.
+*
+* MAP_DEFINE(Name, KeyType, ValueType, destroyValue) defines:
+*   Name - The map type.
+*   NameCursor - An external cursor over a Name map.
+*   NameCreate() - Creates a new empty map.
+*   NameDestroy() - Deletes a map and destroys all its values.
+*   NameGetSize() - Returns the number of keys in a map.
+*   NameContains() - Checks if a key exists inside the map.
+*   NameGet() - Returns the value of a key, NULL if the key is missing.
+*   NameGetMany() - Returns the values of many keys at once, overlapping their searches like mapGetMany.
+*   NamePut() - Gives a key a value the map takes ownership of. A value it replaces is destroyed.
+*   NameGetOrCreate() - Returns the value of a key, creating and inserting it first if the key is missing. The key is searched once.
+*   NameRemove() - Removes a key and destroys its value.
+*   NameCursorFirst() - Sets a cursor to the smallest key of the map.
+*   NameCursorNext() - Advances a cursor to the next key.
+*   NameCursorKey() - Returns the key a cursor points at.
+*   NameCursorValue() - Returns the value a cursor points at.
+*   MAP_FOREACH_TYPED - A macro for iterating over a Name map with a cursor.
+*
+* MAP_DEFINE belongs at file scope of the source file using the map; everything it defines is static.
+* A cursor is valid until its map is modified.
+*/
+
+#define TYPED_MAP_MIN_DEGREE 8
+#define TYPED_MAP_MAX_ELEMENTS (2 * TYPED_MAP_MIN_DEGREE - 1)
+#define TYPED_MAP_MIN_ELEMENTS (TYPED_MAP_MIN_DEGREE - 1)
+#define TYPED_MAP_NODES_PER_SLAB 64
+#define TYPED_MAP_GET_MANY_LANES 8
+
+#define MAP_DEFINE(Name, KeyType, ValueType, destroyValue) \
+\
+/* one spare slot: a node may overflow by one element right before it is split */ \
+typedef struct Name##Node_t { \
+    int size; \
+    bool isLeaf; \
+    KeyType keys[TYPED_MAP_MAX_ELEMENTS + 1]; \
+    ValueType values[TYPED_MAP_MAX_ELEMENTS + 1]; \
+    struct Name##Node_t* children[TYPED_MAP_MAX_ELEMENTS + 2]; \
+} *Name##Node; \
+\
+/* same as MapPath: the child descended into at every level, the element itself at the deepest one */ \
+typedef struct Name##Path_t { \
+    Name##Node nodes[MAP_MAX_DEPTH]; \
+    int indices[MAP_MAX_DEPTH]; \
+    int depth; \
+} Name##Path; \
+\
+typedef struct Name##_t { \
+    Name##Node root; \
+    int size; \
+} *Name; \
+\
+typedef struct Name##Cursor_t { \
+    Name##Path path; \
+} Name##Cursor; \
+\
+static Pool Name##NodePool = POOL_INITIALIZER(struct Name##Node_t, TYPED_MAP_NODES_PER_SLAB); \
+\
+static inline Name##Node Name##NodeCreate(bool isLeaf) \
+{ \
+    Name##Node node = poolAlloc(&Name##NodePool); \
+    if(node == NULL) \
+        return NULL; \
+    node->size = 0; \
+    node->isLeaf = isLeaf; \
+    return node; \
+} \
+\
+static inline void Name##NodeDestroy(Name##Node node) \
+{ \
+    if(node == NULL) \
+        return; \
+    for(int i = 0; i < node->size; i++) \
+        destroyValue(node->values[i]); \
+    if(!node->isLeaf) \
+    { \
+        for(int i = 0; i <= node->size; i++) \
+            Name##NodeDestroy(node->children[i]); \
+    } \
+    poolFree(&Name##NodePool, node); \
+} \
+\
+/* returns the first index in node whose key is not smaller than key */ \
+static inline int Name##SearchNode(Name##Node node, KeyType key, bool* found) \
+{ \
+    int low = 0, high = node->size; \
+    while(low < high) \
+    { \
+        int middle = (low + high) / 2; \
+        if(node->keys[middle] < key) \
+            low = middle + 1; \
+        else \
+            high = middle; \
+    } \
+    *found = low < node->size && !(key < node->keys[low]); \
+    return low; \
+} \
+\
+static inline bool Name##FindPath(Name map, KeyType key, Name##Path* path) \
+{ \
+    path->depth = -1; \
+    Name##Node node = map->root; \
+    while(node != NULL) \
+    { \
+        bool found; \
+        int index = Name##SearchNode(node, key, &found); \
+        path->depth++; \
+        assert(path->depth < MAP_MAX_DEPTH); \
+        path->nodes[path->depth] = node; \
+        path->indices[path->depth] = index; \
+        if(found) \
+            return true; \
+        node = node->isLeaf ? NULL : node->children[index]; \
+    } \
+    return false; \
+} \
+\
+static inline Name Name##Create(void) \
+{ \
+    Name map = malloc(sizeof(*map)); \
+    if(map == NULL) \
+        return NULL; \
+    map->root = NULL; \
+    map->size = 0; \
+    return map; \
+} \
+\
+static inline void Name##Destroy(Name map) \
+{ \
+    if(map == NULL) \
+        return; \
+    Name##NodeDestroy(map->root); \
+    free(map); \
+} \
+\
+static inline int Name##GetSize(Name map) \
+{ \
+    return map == NULL ? -1 : map->size; \
+} \
+\
+static inline ValueType Name##Get(Name map, KeyType key) \
+{ \
+    Name##Node node = map == NULL ? NULL : map->root; \
+    while(node != NULL) \
+    { \
+        bool found; \
+        int index = Name##SearchNode(node, key, &found); \
+        if(found) \
+            return node->values[index]; \
+        node = node->isLeaf ? NULL : node->children[index]; \
+    } \
+    return NULL; \
+} \
+\
+/* searches up to TYPED_MAP_GET_MANY_LANES keys side by side, one level of every key per round, see mapGetMany */ \
+static inline void Name##GetMany(Name map, const KeyType* keys, int count, ValueType* values) \
+{ \
+    for(int first = 0; first < count; first += TYPED_MAP_GET_MANY_LANES) \
+    { \
+        int lanes = count - first < TYPED_MAP_GET_MANY_LANES ? count - first : TYPED_MAP_GET_MANY_LANES; \
+        Name##Node nodes[TYPED_MAP_GET_MANY_LANES]; \
+        int active = 0; \
+        for(int i = 0; i < lanes; i++) \
+        { \
+            values[first + i] = NULL; \
+            nodes[i] = map == NULL ? NULL : map->root; \
+            active += nodes[i] != NULL; \
+        } \
+        while(active > 0) \
+        { \
+            active = 0; \
+            for(int i = 0; i < lanes; i++) \
+            { \
+                Name##Node node = nodes[i]; \
+                if(node == NULL) \
+                    continue; \
+                bool found; \
+                int index = Name##SearchNode(node, keys[first + i], &found); \
+                if(found) \
+                    values[first + i] = node->values[index]; \
+                nodes[i] = found || node->isLeaf ? NULL : node->children[index]; \
+                if(nodes[i] != NULL) \
+                { \
+                    MAP_PREFETCH(nodes[i]); \
+                    MAP_PREFETCH(nodes[i]->keys + TYPED_MAP_MAX_ELEMENTS); \
+                    active++; \
+                } \
+            } \
+        } \
+    } \
+} \
+\
+static inline bool Name##Contains(Name map, KeyType key) \
+{ \
+    return Name##Get(map, key) != NULL; \
+} \
+\
+static inline void Name##InsertIntoNode(Name##Node node, int index, KeyType key, ValueType value, Name##Node rightChild) \
+{ \
+    int toMove = node->size - index; \
+    memmove(node->keys + index + 1, node->keys + index, toMove * sizeof(*node->keys)); \
+    memmove(node->values + index + 1, node->values + index, toMove * sizeof(*node->values)); \
+    node->keys[index] = key; \
+    node->values[index] = value; \
+    if(!node->isLeaf) \
+    { \
+        memmove(node->children + index + 2, node->children + index + 1, toMove * sizeof(*node->children)); \
+        node->children[index + 1] = rightChild; \
+    } \
+    node->size++; \
+} \
+\
+static inline void Name##RemoveFromNode(Name##Node node, int index) \
+{ \
+    int toMove = node->size - index - 1; \
+    memmove(node->keys + index, node->keys + index + 1, toMove * sizeof(*node->keys)); \
+    memmove(node->values + index, node->values + index + 1, toMove * sizeof(*node->values)); \
+    if(!node->isLeaf) \
+        memmove(node->children + index + 1, node->children + index + 2, toMove * sizeof(*node->children)); \
+    node->size--; \
+} \
+\
+/* inserts at the leaf slot recorded in path, all the nodes splits need are allocated first */ \
+static inline MapResult Name##InsertAtPath(Name map, Name##Path* path, KeyType key, ValueType value) \
+{ \
+    if(map->root == NULL) \
+    { \
+        map->root = Name##NodeCreate(true); \
+        if(map->root == NULL) \
+            return MAP_OUT_OF_MEMORY; \
+        Name##InsertIntoNode(map->root, 0, key, value, NULL); \
+        map->size++; \
+        return MAP_SUCCESS; \
+    } \
+\
+    Name##Node spares[MAP_MAX_DEPTH + 1]; \
+    int needed = 0; \
+    for(int level = path->depth; level >= 0 && path->nodes[level]->size == TYPED_MAP_MAX_ELEMENTS; level--) \
+        needed++; \
+    needed += (needed == path->depth + 1); \
+    for(int i = 0; i < needed; i++) \
+    { \
+        spares[i] = Name##NodeCreate(false); \
+        if(spares[i] == NULL) \
+        { \
+            while(i-- > 0) \
+                poolFree(&Name##NodePool, spares[i]); \
+            return MAP_OUT_OF_MEMORY; \
+        } \
+    } \
+\
+    map->size++; \
+    Name##Node rightChild = NULL; \
+    for(int level = path->depth; level >= 0; level--) \
+    { \
+        Name##Node node = path->nodes[level]; \
+        Name##InsertIntoNode(node, path->indices[level], key, value, rightChild); \
+        if(node->size <= TYPED_MAP_MAX_ELEMENTS) \
+            return MAP_SUCCESS; \
+\
+        /* split: the upper half moves to a new right sibling, the median goes up */ \
+        rightChild = spares[--needed]; \
+        rightChild->isLeaf = node->isLeaf; \
+        int toMove = node->size - TYPED_MAP_MIN_DEGREE - 1; \
+        memcpy(rightChild->keys, node->keys + TYPED_MAP_MIN_DEGREE + 1, toMove * sizeof(*node->keys)); \
+        memcpy(rightChild->values, node->values + TYPED_MAP_MIN_DEGREE + 1, toMove * sizeof(*node->values)); \
+        if(!node->isLeaf) \
+            memcpy(rightChild->children, node->children + TYPED_MAP_MIN_DEGREE + 1, (toMove + 1) * sizeof(*node->children)); \
+        rightChild->size = toMove; \
+        node->size = TYPED_MAP_MIN_DEGREE; \
+        key = node->keys[TYPED_MAP_MIN_DEGREE]; \
+        value = node->values[TYPED_MAP_MIN_DEGREE]; \
+    } \
+\
+    Name##Node newRoot = spares[--needed]; \
+    newRoot->keys[0] = key; \
+    newRoot->values[0] = value; \
+    newRoot->children[0] = map->root; \
+    newRoot->children[1] = rightChild; \
+    newRoot->size = 1; \
+    map->root = newRoot; \
+    return MAP_SUCCESS; \
+} \
+\
+static inline MapResult Name##Put(Name map, KeyType key, ValueType value) \
+{ \
+    if(map == NULL || value == NULL) \
+        return MAP_NULL_ARGUMENT; \
+    Name##Path path; \
+    if(Name##FindPath(map, key, &path)) \
+    { \
+        ValueType* slot = &path.nodes[path.depth]->values[path.indices[path.depth]]; \
+        if(*slot != value) \
+            destroyValue(*slot); \
+        *slot = value; \
+        return MAP_SUCCESS; \
+    } \
+    return Name##InsertAtPath(map, &path, key, value); \
+} \
+\
+/* on failure nothing is inserted and a created value is destroyed again */ \
+static inline ValueType Name##GetOrCreate(Name map, KeyType key, ValueType (*create)(KeyType)) \
+{ \
+    if(map == NULL || create == NULL) \
+        return NULL; \
+    Name##Path path; \
+    if(Name##FindPath(map, key, &path)) \
+        return path.nodes[path.depth]->values[path.indices[path.depth]]; \
+    ValueType value = create(key); \
+    if(value == NULL) \
+        return NULL; \
+    if(Name##InsertAtPath(map, &path, key, value) != MAP_SUCCESS) \
+    { \
+        destroyValue(value); \
+        return NULL; \
+    } \
+    return value; \
+} \
+\
+/* moves the last element of the left sibling of parent->children[index] through the parent into it */ \
+static inline void Name##RotateRight(Name##Node parent, int index) \
+{ \
+    Name##Node node = parent->children[index]; \
+    Name##Node left = parent->children[index - 1]; \
+    memmove(node->keys + 1, node->keys, node->size * sizeof(*node->keys)); \
+    memmove(node->values + 1, node->values, node->size * sizeof(*node->values)); \
+    if(!node->isLeaf) \
+    { \
+        memmove(node->children + 1, node->children, (node->size + 1) * sizeof(*node->children)); \
+        node->children[0] = left->children[left->size]; \
+    } \
+    node->keys[0] = parent->keys[index - 1]; \
+    node->values[0] = parent->values[index - 1]; \
+    node->size++; \
+    parent->keys[index - 1] = left->keys[left->size - 1]; \
+    parent->values[index - 1] = left->values[left->size - 1]; \
+    left->size--; \
+} \
+\
+/* moves the first element of the right sibling of parent->children[index] through the parent into it */ \
+static inline void Name##RotateLeft(Name##Node parent, int index) \
+{ \
+    Name##Node node = parent->children[index]; \
+    Name##Node right = parent->children[index + 1]; \
+    Name##InsertIntoNode(node, node->size, parent->keys[index], parent->values[index], right->children[0]); \
+    parent->keys[index] = right->keys[0]; \
+    parent->values[index] = right->values[0]; \
+    if(!right->isLeaf) \
+        memmove(right->children, right->children + 1, right->size * sizeof(*right->children)); \
+    right->size--; \
+    memmove(right->keys, right->keys + 1, right->size * sizeof(*right->keys)); \
+    memmove(right->values, right->values + 1, right->size * sizeof(*right->values)); \
+} \
+\
+/* merges parent->children[index + 1] and the element separating them into parent->children[index] */ \
+static inline void Name##MergeChildren(Name##Node parent, int index) \
+{ \
+    Name##Node left = parent->children[index]; \
+    Name##Node right = parent->children[index + 1]; \
+    left->keys[left->size] = parent->keys[index]; \
+    left->values[left->size] = parent->values[index]; \
+    memcpy(left->keys + left->size + 1, right->keys, right->size * sizeof(*right->keys)); \
+    memcpy(left->values + left->size + 1, right->values, right->size * sizeof(*right->values)); \
+    if(!left->isLeaf) \
+        memcpy(left->children + left->size + 1, right->children, (right->size + 1) * sizeof(*right->children)); \
+    left->size += right->size + 1; \
+    Name##RemoveFromNode(parent, index); \
+    poolFree(&Name##NodePool, right); \
+} \
+\
+/* unlinks the element path points at, replacing an inner one by its predecessor, and fixes the nodes upwards */ \
+static inline void Name##RemoveAtPath(Name map, Name##Path* path) \
+{ \
+    Name##Node node = path->nodes[path->depth]; \
+    int index = path->indices[path->depth]; \
+    destroyValue(node->values[index]); \
+    if(node->isLeaf) \
+        Name##RemoveFromNode(node, index); \
+    else \
+    { \
+        Name##Node leaf = node->children[index]; \
+        while(!leaf->isLeaf) \
+        { \
+            path->depth++; \
+            path->nodes[path->depth] = leaf; \
+            path->indices[path->depth] = leaf->size; \
+            leaf = leaf->children[leaf->size]; \
+        } \
+        path->depth++; \
+        path->nodes[path->depth] = leaf; \
+        path->indices[path->depth] = leaf->size - 1; \
+        node->keys[index] = leaf->keys[leaf->size - 1]; \
+        node->values[index] = leaf->values[leaf->size - 1]; \
+        leaf->size--; \
+    } \
+\
+    for(int level = path->depth; level > 0 && path->nodes[level]->size < TYPED_MAP_MIN_ELEMENTS; level--) \
+    { \
+        Name##Node parent = path->nodes[level - 1]; \
+        int childIndex = path->indices[level - 1]; \
+        if(childIndex > 0 && parent->children[childIndex - 1]->size > TYPED_MAP_MIN_ELEMENTS) \
+            Name##RotateRight(parent, childIndex); \
+        else if(childIndex < parent->size && parent->children[childIndex + 1]->size > TYPED_MAP_MIN_ELEMENTS) \
+            Name##RotateLeft(parent, childIndex); \
+        else \
+            Name##MergeChildren(parent, childIndex > 0 ? childIndex - 1 : childIndex); \
+    } \
+\
+    Name##Node root = map->root; \
+    if(root->size == 0) \
+    { \
+        map->root = root->isLeaf ? NULL : root->children[0]; \
+        poolFree(&Name##NodePool, root); \
+    } \
+    map->size--; \
+} \
+\
+static inline MapResult Name##Remove(Name map, KeyType key) \
+{ \
+    if(map == NULL) \
+        return MAP_NULL_ARGUMENT; \
+    Name##Path path; \
+    if(!Name##FindPath(map, key, &path)) \
+        return MAP_ITEM_DOES_NOT_EXIST; \
+    Name##RemoveAtPath(map, &path); \
+    return MAP_SUCCESS; \
+} \
+\
+static inline bool Name##CursorFirst(Name map, Name##Cursor* cursor) \
+{ \
+    cursor->path.depth = -1; \
+    Name##Node node = map == NULL ? NULL : map->root; \
+    while(node != NULL) \
+    { \
+        cursor->path.depth++; \
+        cursor->path.nodes[cursor->path.depth] = node; \
+        cursor->path.indices[cursor->path.depth] = 0; \
+        node = node->isLeaf ? NULL : node->children[0]; \
+    } \
+    return cursor->path.depth >= 0; \
+} \
+\
+static inline bool Name##CursorNext(Name##Cursor* cursor) \
+{ \
+    Name##Path* path = &cursor->path; \
+    if(path->depth < 0) \
+        return false; \
+    Name##Node node = path->nodes[path->depth]; \
+    if(!node->isLeaf) \
+    { \
+        node = node->children[++path->indices[path->depth]]; \
+        while(node != NULL) \
+        { \
+            path->depth++; \
+            path->nodes[path->depth] = node; \
+            path->indices[path->depth] = 0; \
+            node = node->isLeaf ? NULL : node->children[0]; \
+        } \
+        return true; \
+    } \
+    if(++path->indices[path->depth] < node->size) \
+        return true; \
+    while(--path->depth >= 0) \
+    { \
+        if(path->indices[path->depth] < path->nodes[path->depth]->size) \
+            return true; \
+    } \
+    return false; \
+} \
+\
+static inline KeyType Name##CursorKey(Name##Cursor* cursor) \
+{ \
+    assert(cursor->path.depth >= 0); \
+    return cursor->path.nodes[cursor->path.depth]->keys[cursor->path.indices[cursor->path.depth]]; \
+} \
+\
+static inline ValueType Name##CursorValue(Name##Cursor* cursor) \
+{ \
+    if(cursor->path.depth < 0) \
+        return NULL; \
+    return cursor->path.nodes[cursor->path.depth]->values[cursor->path.indices[cursor->path.depth]]; \
+}
+
+/**
+ * @brief Macro for iterating over a map defined by MAP_DEFINE in increasing key order. Declares the cursor
+ * for the loop; inside it, NameCursorKey and NameCursorValue return the current key and value.
+ */
+#define MAP_FOREACH_TYPED(Name, cursor, map) \
+    for(Name##Cursor cursor, *cursor##Once = &cursor; cursor##Once; cursor##Once = NULL) \
+        for(bool cursor##Valid = Name##CursorFirst(map, &cursor) ; \
+            cursor##Valid ;\
+            cursor##Valid = Name##CursorNext(&cursor))
+
+#endif /* TypedMap_h */
@@ -59,5 +59,9 @@ int GameGetPlayer1ID(Game game)   { return game->player1ID; }
 int GameGetPlayer2ID(Game game)   { return game->player2ID; }
 int GameGetWinner(Game game)      { return game->winnerID;  }
 
-
-
+uint64_t GamePlayersKey(int player1ID, int player2ID)
+{
+    uint32_t low = player1ID < player2ID ? player1ID : player2ID;
+    uint32_t high = player1ID < player2ID ? player2ID : player1ID;
+    return ((uint64_t) low << 32) | high;
+}
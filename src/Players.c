@@ -5,9 +5,23 @@
 #include <stdbool.h>
 #include <assert.h>
 #include "../includes/Player.h"
-#include "../lib/map.h"
+#include "../lib/Map.h"
 #include "../utilities.h"
 
+#define INLINE_TOURNAMENTS 4
+
+typedef struct tournament_games_t
+{
+   int tournamentID;
+   int gamesCount;
+} TournamentGames;
+
+/** Note:
+ * The tournaments of a player are a sorted array of (tournament, games) pairs. Most players play in a few
+ * tournaments only, so the first INLINE_TOURNAMENTS pairs live inside the Player itself and a player costs
+ * a single allocation; only a player of more tournaments moves them to a separately allocated array, which
+ * then grows by doubling. Lookups are binary searches either way.
+ */
 struct Player_t
 {
    int playerID;
@@ -16,10 +30,49 @@ struct Player_t
    int drawsCount;
    int totalPlayedGames;
    int totalPlayingTime;
-   Map playerTournaments;
+   TournamentGames* tournaments;
+   int tournamentsCount;
+   int tournamentsCapacity;
+   TournamentGames inlineTournaments[INLINE_TOURNAMENTS];
    bool stillParticipating;
 };
 
+static bool isSpilled(Player player) { return player->tournaments != player->inlineTournaments; }
+
+// the index of tournamentID in the player's tournaments, or the index it belongs at if it is missing
+static int findTournament(Player player, int tournamentID, bool* found)
+{
+   int low = 0, high = player->tournamentsCount;
+   while(low < high)
+   {
+      int middle = low + (high - low) / 2;
+      if(player->tournaments[middle].tournamentID < tournamentID)
+         low = middle + 1;
+      else
+         high = middle;
+   }
+   *found = low < player->tournamentsCount && player->tournaments[low].tournamentID == tournamentID;
+   return low;
+}
+
+static bool reserveTournaments(Player player, int needed)
+{
+   if(needed <= player->tournamentsCapacity)
+      return true;
+   int capacity = player->tournamentsCapacity;
+   while(capacity < needed)
+      capacity *= 2;
+   TournamentGames* tournaments = isSpilled(player) ?
+         realloc(player->tournaments, capacity * sizeof(*tournaments)) : malloc(capacity * sizeof(*tournaments));
+   if(tournaments == NULL)
+      return false;
+   if(!isSpilled(player))
+      memcpy(tournaments, player->inlineTournaments, player->tournamentsCount * sizeof(*tournaments));
+   player->tournaments = tournaments;
+   player->tournamentsCapacity = capacity;
+   return true;
+}
+
 Player PlayerCreate(int playerID)
 {
    Player newPlayer = malloc(sizeof(*newPlayer));
@@ -30,21 +83,18 @@ Player PlayerCreate(int playerID)
    newPlayer->drawsCount = newPlayer->lossesCount = newPlayer->winsCount = 0;
    newPlayer->totalPlayedGames = newPlayer->totalPlayingTime = 0;
    newPlayer->stillParticipating = true;
-
-   newPlayer->playerTournaments = mapCreate(copyIntKey, copyIntKey, freeIntKey, freeIntKey, compareIntKey);
-   if(newPlayer->playerTournaments == NULL)
-   {
-      free(newPlayer);
-      return NULL;
-   }
+   newPlayer->tournaments = newPlayer->inlineTournaments;
+   newPlayer->tournamentsCount = 0;
+   newPlayer->tournamentsCapacity = INLINE_TOURNAMENTS;
    return newPlayer;
 }
 
 void PlayerDestroy(void *p)
 {
    Player player = (Player) p;
-   if(player == NULL) return NULL;
-   mapDestroy(player->playerTournaments);
+   if(player == NULL) return;
+   if(isSpilled(player))
+      free(player->tournaments);
    free(player);
 }
 
@@ -61,15 +111,15 @@ void* PlayerCopy(void *p)
    newPlayer->drawsCount = player->drawsCount;
    newPlayer->totalPlayingTime = player->totalPlayingTime;
    newPlayer->totalPlayedGames = player->totalPlayedGames;
+   newPlayer->stillParticipating = player->stillParticipating;
 
-   Map copiedMap = mapCopy(player->playerTournaments);
-   if(newPlayer->playerTournaments == NULL)
+   if(!reserveTournaments(newPlayer, player->tournamentsCount))
    {
-      playerDestroy(newPlayer);
+      PlayerDestroy(newPlayer);
       return NULL;
    }
-   mapDestroy(newPlayer->playerTournaments); // a map has been created in PlayerCreate
-   newPlayer->playerTournaments = copiedMap;
+   memcpy(newPlayer->tournaments, player->tournaments, player->tournamentsCount * sizeof(*player->tournaments));
+   newPlayer->tournamentsCount = player->tournamentsCount;
    return newPlayer;
 }
 
@@ -81,14 +131,27 @@ int PlayerGetTotalPlayTime (Player player)   { return player->totalPlayingTime;
 int PlayerGetPlayerID (Player player)        { return player->playerID;           }
 int PlayerGetNumOfPlayedGames(Player player) { return player->totalPlayedGames;   }
 bool PlayerIsPlayerDeleted(Player player)    { return !player->stillParticipating;}
-Map playerGetTournamentsList(Player player)  { return player->playerTournaments;  }
+int PlayerGetNumOfTournaments(Player player) { return player->tournamentsCount;   }
+int PlayerGetTournamentID(Player player, int index)
+{
+   assert(index >= 0 && index < player->tournamentsCount);
+   return player->tournaments[index].tournamentID;
+}
 
+void PlayerAddGame(Player player)            { player->totalPlayedGames++; }
 void PlayerAddWin(Player player)             { player->winsCount++;    }
 void PlayerAddLoss(Player player)            { player->lossesCount++;  }
 void PlayerAddDraw(Player player)            { player->drawsCount++;   }
 void PlayerRemoveWin(Player player)          { player->winsCount--;    }
 void PlayerRemoveLoss(Player player)         { player->lossesCount--;  }
 void PlayerRemoveDraw(Player player)         { player->drawsCount--;   }
+void PlayerRemoveResults(Player player, int games, int wins, int losses, int draws)
+{
+   player->totalPlayedGames -= games;
+   player->winsCount -= wins;
+   player->lossesCount -= losses;
+   player->drawsCount -= draws;
+}
 
 void PlayerAddPlayTime(Player player, int timePlayed) { player->totalPlayingTime += timePlayed; }
 void PlayerRemovePlayer(Player player)       { player->stillParticipating = false; }
@@ -96,3 +159,41 @@ void PlayerResetStats(Player player) {
    player->winsCount = player->lossesCount = player->drawsCount = 0;
    player->totalPlayedGames = player->totalPlayingTime = 0;
 }
+
+bool PlayerAddTournamentGame(Player player, int tournamentID)
+{
+   bool found;
+   int index = findTournament(player, tournamentID, &found);
+   if(found)
+   {
+      player->tournaments[index].gamesCount++;
+      return true;
+   }
+   if(!reserveTournaments(player, player->tournamentsCount + 1))
+      return false;
+   memmove(player->tournaments + index + 1, player->tournaments + index,
+           (player->tournamentsCount - index) * sizeof(*player->tournaments));
+   player->tournaments[index].tournamentID = tournamentID;
+   player->tournaments[index].gamesCount = 1;
+   player->tournamentsCount++;
+   return true;
+}
+
+bool PlayerRemoveTournament(Player player, int tournamentID)
+{
+   bool found;
+   int index = findTournament(player, tournamentID, &found);
+   if(!found)
+      return false;
+   player->tournamentsCount--;
+   memmove(player->tournaments + index, player->tournaments + index + 1,
+           (player->tournamentsCount - index) * sizeof(*player->tournaments));
+   return true;
+}
+
+int PlayerGetTournamentGames(Player player, int tournamentID)
+{
+   bool found;
+   int index = findTournament(player, tournamentID, &found);
+   return found ? player->tournaments[index].gamesCount : 0;
+}
@@ -7,24 +7,279 @@
 #include "../includes/Tournament.h"
 #include "../includes/Game.h"
 #include "../includes/Player.h"
+#include "../includes/chessSystem.h"
 #include "../utilities.h"
+#include "../lib/Pool.h"
 
 #define ON_GOING 0
 #define ENDED 1
+#define PAIR_KEYS_PER_SLAB 256
+#define STANDINGS_PER_SLAB 256
+#define INITIAL_GAMES_CAPACITY 16
+
+/** Note:
+ * The games of a tournament are kept as columns (a struct of arrays): the i-th game is player1[i],
+ * player2[i], winner[i] and playTime[i]. A scan over one attribute reads one contiguous array, which
+ * the compiler can vectorize, instead of following a map node and a separately allocated Game per game.
+ * Games are only ever appended, a game's index is the order in which it was added.
+ * The games of each player are also linked from the latest to the earliest (an adjacency list threaded
+ * through the columns): nextOfPlayer1[i] is the previous game of player1[i], nextOfPlayer2[i] that of
+ * player2[i], and the standing of a player holds the player's latest game. -1 ends a list.
+ */
+typedef struct game_log_t {
+    int* player1;
+    int* player2;
+    int* playTime;
+    int* nextOfPlayer1;
+    int* nextOfPlayer2;
+    int8_t* winner;
+    int size;
+    int capacity;
+} GameLog;
 
 struct Tournament_t
 {
     int tournamentID;
     int maxGamesPerPlayer;
-    int maxPlayingTime;
-    int totalGamesPlayed;
-    int totalTimePlayed;
+    TournamentStats stats;
     char* tournamentLocation;
     int winnerID;
-    Map gamesMap;
+    GameLog games;
+    Map gamePairs;
+    Map standings;
     bool hasTournamentEnded;
 };
 
+typedef struct standing_t {
+    int games;
+    int wins;
+    int losses;
+    int draws;
+    int playTime;
+    int lastGame;
+    bool removed;
+} Standing;
+
+/** Note:
+ * gamePairs maps the GamePlayersKey of every pair of players who played in the tournament to the number
+ * of their games, and standings maps every player's ID to the player's games, wins, losses, draws and
+ * play time in it.
+ * Both are hashed and kept in step with the games, so checking whether two players already met or
+ * whether a player reached the games limit is O(1) and needs no allocation, instead of a walk over all the games,
+ * and ending or removing the tournament is one pass over its players.
+ */
+static Pool pairKeyPool = POOL_INITIALIZER(uint64_t, PAIR_KEYS_PER_SLAB);
+static Pool standingPool = POOL_INITIALIZER(Standing, STANDINGS_PER_SLAB);
+
+static void* copyPairKey(void* key)
+{
+    uint64_t* newKey = poolAlloc(&pairKeyPool);
+    if(newKey == NULL)
+        return NULL;
+    *newKey = *(uint64_t*) key;
+    return newKey;
+}
+
+static void freePairKey(void* key)
+{
+    poolFree(&pairKeyPool, key);
+}
+
+static int comparePairKeys(void* key1, void* key2)
+{
+    uint64_t pair1 = *(uint64_t*) key1, pair2 = *(uint64_t*) key2;
+    return pair1 < pair2 ? -1 : pair1 > pair2;
+}
+
+static unsigned int hashPairKey(void* key)
+{
+    uint64_t pair = *(uint64_t*) key;
+    return (unsigned int) (pair ^ (pair >> 32));
+}
+
+static void* copyStanding(void* standing)
+{
+    Standing* newStanding = poolAlloc(&standingPool);
+    if(newStanding == NULL)
+        return NULL;
+    *newStanding = *(Standing*) standing;
+    return newStanding;
+}
+
+static void freeStanding(void* standing)
+{
+    poolFree(&standingPool, standing);
+}
+
+// counters are changed in place, so they are reached through entries, which never share them with a copy
+
+// raises the counter of key by one, adding it at one if it is missing; false if out of memory
+static bool countUp(Map counters, void* key)
+{
+    int none = 0;
+    int* counter = mapGetOrPut(counters, key, &none);
+    if(counter == NULL)
+        return false;
+    (*counter)++;
+    return true;
+}
+
+// lowers a counter countUp raised, removing it once it drops to zero
+static void countDown(Map counters, void* key)
+{
+    MapEntry entry;
+    mapEntryFind(counters, key, &entry);
+    int* counter = mapEntryGet(&entry);
+    assert(counter != NULL);
+    if(*counter > 1)
+        (*counter)--;
+    else
+        mapEntryRemove(&entry);
+}
+
+// adds (delta 1) or takes back (delta -1) the result of a game from the standings of its players
+static void recordResult(Standing* standing1, Standing* standing2, int winner, int delta)
+{
+    switch (winner)
+    {
+        case FIRST_PLAYER:
+            standing1->wins += delta;
+            standing2->losses += delta;
+            break;
+        case SECOND_PLAYER:
+            standing2->wins += delta;
+            standing1->losses += delta;
+            break;
+        case DRAW:
+            standing1->draws += delta;
+            standing2->draws += delta;
+            break;
+    }
+}
+
+/**
+ * Counts the game-th game, between the two players, in the counters and standings of the tournament
+ * and links it first in both players' lists of games. On failure nothing is counted.
+ */
+static bool countGame(Tournament tournament, int game, int player1ID, int player2ID, int winner, int playTime)
+{
+    uint64_t pair = GamePlayersKey(player1ID, player2ID);
+    if(!countUp(tournament->gamePairs, &pair))
+        return false;
+
+    Standing none = { 0, 0, 0, 0, 0, -1, false };
+    Standing* standing1 = mapGetOrPut(tournament->standings, &player1ID, &none);
+    Standing* standing2 = standing1 ? mapGetOrPut(tournament->standings, &player2ID, &none) : NULL;
+    if(standing2 == NULL)
+    {
+        if(standing1 != NULL && standing1->games == 0)
+            mapRemove(tournament->standings, &player1ID);
+        countDown(tournament->gamePairs, &pair);
+        return false;
+    }
+
+    standing1->games++;
+    standing2->games++;
+    standing1->playTime += playTime;
+    standing2->playTime += playTime;
+    recordResult(standing1, standing2, winner, 1);
+    tournament->games.nextOfPlayer1[game] = standing1->lastGame;
+    tournament->games.nextOfPlayer2[game] = standing2->lastGame;
+    standing1->lastGame = standing2->lastGame = game;
+    return true;
+}
+
+/**
+ * Orders players by the rules of chessEndTournament: a higher score (wins * 2 + draws) / games first,
+ * then fewer losses, then more wins, then a smaller ID. The scores are compared by cross multiplication,
+ * which is exact. Returns true if the first player ranks above the second.
+ */
+static bool ranksAbove(int player1ID, const Standing* standing1, int player2ID, const Standing* standing2)
+{
+    long long score1 = (long long) (standing1->wins * 2 + standing1->draws) * standing2->games;
+    long long score2 = (long long) (standing2->wins * 2 + standing2->draws) * standing1->games;
+    if(score1 != score2)
+        return score1 > score2;
+    if(standing1->losses != standing2->losses)
+        return standing1->losses < standing2->losses;
+    if(standing1->wins != standing2->wins)
+        return standing1->wins > standing2->wins;
+    return player1ID < player2ID;
+}
+
+// makes room for needed games; the columns grow one by one, a failure leaves the grown ones usable
+static bool gameLogReserve(GameLog* games, int needed)
+{
+    if(needed <= games->capacity)
+        return true;
+    int capacity = games->capacity == 0 ? INITIAL_GAMES_CAPACITY : games->capacity;
+    while(capacity < needed)
+        capacity *= 2;
+
+    int* player1 = realloc(games->player1, capacity * sizeof(*player1));
+    if(player1 == NULL)
+        return false;
+    games->player1 = player1;
+    int* player2 = realloc(games->player2, capacity * sizeof(*player2));
+    if(player2 == NULL)
+        return false;
+    games->player2 = player2;
+    int* playTime = realloc(games->playTime, capacity * sizeof(*playTime));
+    if(playTime == NULL)
+        return false;
+    games->playTime = playTime;
+    int* nextOfPlayer1 = realloc(games->nextOfPlayer1, capacity * sizeof(*nextOfPlayer1));
+    if(nextOfPlayer1 == NULL)
+        return false;
+    games->nextOfPlayer1 = nextOfPlayer1;
+    int* nextOfPlayer2 = realloc(games->nextOfPlayer2, capacity * sizeof(*nextOfPlayer2));
+    if(nextOfPlayer2 == NULL)
+        return false;
+    games->nextOfPlayer2 = nextOfPlayer2;
+    int8_t* winner = realloc(games->winner, capacity * sizeof(*winner));
+    if(winner == NULL)
+        return false;
+    games->winner = winner;
+    games->capacity = capacity;
+    return true;
+}
+
+static void gameLogFree(GameLog* games)
+{
+    free(games->player1);
+    free(games->player2);
+    free(games->playTime);
+    free(games->nextOfPlayer1);
+    free(games->nextOfPlayer2);
+    free(games->winner);
+}
+
+// takes a game's play time into the running statistics, in O(1)
+static void statsAdd(TournamentStats* stats, int playTime)
+{
+    if(stats->gamesCount == 0 || playTime > stats->maxPlayTime)
+        stats->maxPlayTime = playTime;
+    if(stats->gamesCount == 0 || playTime < stats->minPlayTime)
+        stats->minPlayTime = playTime;
+    stats->gamesCount++;
+    stats->totalPlayTime += playTime;
+    stats->sumOfSquares += (double) playTime * playTime;
+}
+
+static bool gameLogCopy(GameLog* destination, const GameLog* source)
+{
+    if(!gameLogReserve(destination, source->size))
+        return false;
+    memcpy(destination->player1, source->player1, source->size * sizeof(*source->player1));
+    memcpy(destination->player2, source->player2, source->size * sizeof(*source->player2));
+    memcpy(destination->playTime, source->playTime, source->size * sizeof(*source->playTime));
+    memcpy(destination->nextOfPlayer1, source->nextOfPlayer1, source->size * sizeof(*source->nextOfPlayer1));
+    memcpy(destination->nextOfPlayer2, source->nextOfPlayer2, source->size * sizeof(*source->nextOfPlayer2));
+    memcpy(destination->winner, source->winner, source->size * sizeof(*source->winner));
+    destination->size = source->size;
+    return true;
+}
+
 Tournament TournamentCreate(int tournamentID, int maxGamesPerPlayer, const char* tournamentLocation)
 {
     Tournament newTournament = malloc(sizeof(*newTournament));
@@ -33,8 +288,9 @@ Tournament TournamentCreate(int tournamentID, int maxGamesPerPlayer, const char*
 
     newTournament->tournamentID = tournamentID;
     newTournament->maxGamesPerPlayer = maxGamesPerPlayer;
-    newTournament->maxPlayingTime = newTournament->winnerID = 0;
-    newTournament->totalTimePlayed = newTournament->totalGamesPlayed = 0;
+    newTournament->winnerID = 0;
+    newTournament->stats = (TournamentStats) { 0, 0, 0, 0, 0 };
+    newTournament->games = (GameLog) { NULL, NULL, NULL, NULL, NULL, NULL, 0, 0 };
     newTournament->hasTournamentEnded = ON_GOING;
 
     int length = strlen(tournamentLocation);
@@ -46,22 +302,18 @@ Tournament TournamentCreate(int tournamentID, int maxGamesPerPlayer, const char*
     }
     strcpy(newTournament->tournamentLocation, tournamentLocation);
 
-    newTournament->gamesMap = mapCreate(GameCopy, strcpy, GameDestroy, free, strcmp);
-    if(newTournament->gamesMap == NULL)
+    newTournament->gamePairs = mapCreateHashed(copyIntKey, copyPairKey, freeIntKey, freePairKey,
+                                               comparePairKeys, hashPairKey);
+    newTournament->standings = mapCreateHashed(copyStanding, copyIntKey, freeStanding, freeIntKey,
+                                               compareIntKey, hashIntKey);
+    if(newTournament->gamePairs == NULL || newTournament->standings == NULL)
     {
+        mapDestroy(newTournament->gamePairs);
+        mapDestroy(newTournament->standings);
         free(newTournament->tournamentLocation);
         free(newTournament);
         return NULL;
     }
-
-    // newTournament->participatingPlayers = mapCreate(PlayerCopy, copyIntkey, PlayerDestroy, freeIntKey, Intkeycompare);
-    // if(newTournament->participatingPlayers == NULL)
-    // {
-    //     free(newTournament->tournamentLocation);
-    //     free(newTournament->gamesMap);
-    //     free(newTournament);
-    //     return NULL;
-    // }
     return newTournament;
 }
 
@@ -70,30 +322,28 @@ void* TournamentCopy(void* t)
     Tournament tournament = (Tournament) t;
     if(!tournament) return NULL;
 
-    Tournament newTournament = tournamentCreate(tournament->tournamentID,
+    Tournament newTournament = TournamentCreate(tournament->tournamentID,
                                                 tournament->maxGamesPerPlayer, tournament->tournamentLocation);
     if(newTournament == NULL) return NULL;
 
-    mapDestroy(newTournament->gamesMap); // has been allocated in Create
-    newTournament->gamesMap = mapCopy(tournament->gamesMap);
-    if(!newTournament->gamesMap)
+    if(!gameLogCopy(&newTournament->games, &tournament->games))
+    {
+        TournamentDestroy(newTournament);
+        return NULL;
+    }
+    mapDestroy(newTournament->gamePairs);
+    mapDestroy(newTournament->standings);
+    newTournament->gamePairs = mapCopy(tournament->gamePairs);
+    newTournament->standings = mapCopy(tournament->standings);
+    if(!newTournament->gamePairs || !newTournament->standings)
     {
         TournamentDestroy(newTournament);
         return NULL;
     }
 
-    // mapDestroy(newTournament->participatingPlayers); // has been allocated in Create
-    // newTournament->participatingPlayers = mapCopy(tournament->participatingPlayers);
-    // if(newTournament->participatingPlayers == NULL)
-    // {
-    //     TournamentDestroy(newTournament);
-    //     return NULL;
-    // }
     newTournament->hasTournamentEnded = tournament->hasTournamentEnded;
     newTournament->winnerID = tournament->winnerID;
-    newTournament->totalTimePlayed = tournament->totalTimePlayed;
-    newTournament->totalGamesPlayed = tournament->totalGamesPlayed;
-    newTournament->maxPlayingTime = tournament->maxPlayingTime;
+    newTournament->stats = tournament->stats;
     return newTournament;
 
 }
@@ -104,24 +354,26 @@ void TournamentDestroy(void* t)
     if(!tournament)
         return;
 
-    mapDestroy(tournament->gamesMap);
-    // mapDestroy(tournament->participatingPlayers);
+    gameLogFree(&tournament->games);
+    mapDestroy(tournament->gamePairs);
+    mapDestroy(tournament->standings);
     free(tournament->tournamentLocation);
     free(tournament);
 }
 
-Tournament* TournamentAddGame(Tournament tournament, int player1ID, int player2ID, int winnerID, int playTime)
+bool TournamentAddGame(Tournament tournament, int player1ID, int player2ID, int winnerID, int playTime)
 {
-    Game newGame = GameCreate(player1ID, player2ID, winnerID, playTime);
-    if(!newGame) return NULL;
+    // once there is room for the game and it is counted, appending it cannot fail
+    GameLog* games = &tournament->games;
+    if(!gameLogReserve(games, games->size + 1) || !countGame(tournament, games->size, player1ID, player2ID, winnerID, playTime))
+        return false;
 
-    if(mapPut(tournament->gamesMap, &(tournament->totalGamesPlayed), newGame) == MAP_OUT_OF_MEMORY)
-    {
-        GameDestroy(newGame);
-        return NULL;
-    }
-    tournament->totalGamesPlayed++;
-    tournament->totalTimePlayed += playTime;
+    int game = games->size++;
+    games->player1[game] = player1ID;
+    games->player2[game] = player2ID;
+    games->winner[game] = (int8_t) winnerID;
+    games->playTime[game] = playTime;
+    statsAdd(&tournament->stats, playTime);
     return true;
 }
 
@@ -130,27 +382,42 @@ bool TournamentDoesGameExistBetweenPlayers(Tournament tournament, int player1ID,
     if(!tournament || player1ID == player2ID)
         return false;
 
-    MAP_FOREACH(int*, key, tournament->gamesMap)
-    {
-        Game currGame = mapGet(tournament->gamesMap, key);
-        if(GameIsPlayerInGame(currGame, player1ID) && GameIsPlayerInGame(currGame, player2ID))
-            return true;
-    }
-    return false;
+    uint64_t pair = GamePlayersKey(player1ID, player2ID);
+    return mapContains(tournament->gamePairs, &pair);
 }
 
 bool TournamentHasPlayerReachedGamesLimit(Tournament tournament, int playerID) {
     if (!tournament) return false;
 
-    int playedGames = 0;
-    MAP_FOREACH(int*, key, tournament->gamesMap) {
-        Game currGame = mapGet(tournament->gamesMap, key);
-        playedGames += GameIsPlayerInGame(currGame, playerID);
-    }
+    Standing* standing = mapGet(tournament->standings, &playerID);
+    int playedGames = standing == NULL ? 0 : standing->games;
     return !(playedGames < tournament->maxGamesPerPlayer);
 }
 
+void TournamentRemovePlayer(Tournament tournament, int playerID)
+{
+    MapEntry entry;
+    if(!tournament || !mapEntryFind(tournament->standings, &playerID, &entry))
+        return;
+    // the player's games still count for the opponents, but the player can no longer win
+    Standing* standing = mapEntryGet(&entry);
+    standing->removed = true;
+}
+
 void TournamentEndTournament(Tournament tournament) {
+    // the standings are up to date, the winner is the best of them in a single pass
+    int winnerID = 0;
+    Standing* winner = NULL;
+    MAP_FOREACH_CURSOR(int*, playerID, cursor, tournament->standings)
+    {
+        Standing* standing = mapCursorGetData(&cursor);
+        if(!standing->removed && (winner == NULL || ranksAbove(*playerID, standing, winnerID, winner)))
+        {
+            winnerID = *playerID;
+            winner = standing;
+        }
+    }
+    tournament->winnerID = winnerID;
     tournament->hasTournamentEnded = ENDED;
 }
 
@@ -158,9 +425,66 @@ int TournamentGetID(Tournament tournament)                 { return tournament->
 int TournamentGetMaxGamesPerPlayer(Tournament tournament)  { return tournament->maxGamesPerPlayer; }
 const char* TournamentGetLocation(Tournament tournament)   { return tournament->tournamentLocation; }
 
-Map TournamentGetGamesList(Tournament tournament) { return tournament->gamesMap; }
+void TournamentGetGame(Tournament tournament, int game, int* player1ID, int* player2ID, int* winner, int* playTime)
+{
+    assert(game >= 0 && game < tournament->games.size);
+    *player1ID = tournament->games.player1[game];
+    *player2ID = tournament->games.player2[game];
+    *winner = tournament->games.winner[game];
+    *playTime = tournament->games.playTime[game];
+}
 
-// Map TournamentGetPlayersList(Tournament tournament) { return tournament->participatingPlayers; }
+void TournamentGetPlayerResults(Tournament tournament, int playerID, int* games, int* wins, int* losses, int* draws,
+                                int* playTime)
+{
+    Standing* standing = mapPeek(tournament->standings, &playerID);
+    *games = standing == NULL ? 0 : standing->games;
+    *wins = standing == NULL ? 0 : standing->wins;
+    *losses = standing == NULL ? 0 : standing->losses;
+    *draws = standing == NULL ? 0 : standing->draws;
+    *playTime = standing == NULL ? 0 : standing->playTime;
+}
+
+int TournamentGetPlayerLastGame(Tournament tournament, int playerID)
+{
+    Standing* standing = mapGet(tournament->standings, &playerID);
+    return standing == NULL ? -1 : standing->lastGame;
+}
+
+int TournamentGetPlayerPreviousGame(Tournament tournament, int playerID, int game)
+{
+    assert(game >= 0 && game < tournament->games.size);
+    const GameLog* games = &tournament->games;
+    return games->player1[game] == playerID ? games->nextOfPlayer1[game] : games->nextOfPlayer2[game];
+}
+
+bool TournamentSetGameWinner(Tournament tournament, int game, int winner)
+{
+    assert(game >= 0 && game < tournament->games.size);
+    GameLog* games = &tournament->games;
+    // both standings exist, entries only make them private before they are changed in place
+    MapEntry entry1, entry2;
+    if(!mapEntryFind(tournament->standings, &games->player1[game], &entry1)
+       || !mapEntryFind(tournament->standings, &games->player2[game], &entry2))
+        return false;
+    Standing* standing1 = mapEntryGet(&entry1);
+    Standing* standing2 = mapEntryGet(&entry2);
+    recordResult(standing1, standing2, games->winner[game], -1);
+    recordResult(standing1, standing2, winner, 1);
+    games->winner[game] = (int8_t) winner;
+    return true;
+}
+
+int TournamentGetPlayers(Tournament tournament, int* playerIDs)
+{
+    // the standings are the tournament's participants, walking them costs O(players) and no search
+    int count = 0;
+    MAP_FOREACH_CURSOR(int*, playerID, cursor, tournament->standings)
+    {
+        playerIDs[count++] = *playerID;
+    }
+    return count;
+}
 
 int TournamentGetWinnerID(Tournament tournament) { return tournament->winnerID; }
 
@@ -168,8 +492,9 @@ void TournamentSetWinnerID(Tournament tournament, int winnerID) { tournament->wi
 
 bool TournamentHasTournamentEnded(Tournament tournament) { return tournament->hasTournamentEnded; }
 
-int TournamentGetTotalTime(Tournament tour)     { return tour->totalTimePlayed; }
-int TournamentGetNumOfGames(Tournament tour)    { return tour->totalGamesPlayed; }
+int TournamentGetTotalTime(Tournament tour)     { return tour->stats.totalPlayTime; }
+int TournamentGetNumOfGames(Tournament tour)    { return tour->games.size; }
+int TournamentGetNumOfPlayers(Tournament tour)  { return mapGetSize(tour->standings); }
 
-int TournamentGetMaxPlayingTime(Tournament tour) { return tour->maxPlayingTime; }
-void TournamentSetMaxPlayingTime(Tournament tour, int maxTime) { tour->maxPlayingTime = maxTime; }
+int TournamentGetMaxPlayingTime(Tournament tour) { return tour->stats.maxPlayTime; }
+TournamentStats TournamentGetStats(Tournament tour) { return tour->stats; }
@@ -6,6 +6,7 @@
 
 #include "../utilities.h"
 #include "../lib/Map.h"
+#include "../lib/TypedMap.h"
 #include "../includes/Player.h"
 #include "../includes/Game.h"
 #include "../includes/Tournament.h"
@@ -15,10 +16,13 @@
 #define LOSSES_FACTOR 10
 #define DRAWS_FACTOR 2
 
+MAP_DEFINE(IntTournamentMap, int, Tournament, TournamentDestroy)
+MAP_DEFINE(IntPlayerMap, int, Player, PlayerDestroy)
+
 struct chess_system_t
 {
-    Map tournaments;
-    Map players;
+    IntTournamentMap tournaments;
+    IntPlayerMap players;
     int gamesNumber;
 };
 
@@ -27,17 +31,17 @@ ChessSystem chessCreate()
     ChessSystem newSystem = malloc(sizeof(*newSystem));
     if(!newSystem) return NULL;
 
-    newSystem->tournaments = mapCreate(TournamentCopy, copyIntKey, TournamentDestroy, freeIntKey, compareIntKey);
+    newSystem->tournaments = IntTournamentMapCreate();
     if(!newSystem->tournaments)
     {
         free(newSystem);
         return NULL;
     }
 
-    newSystem->players = mapCreate(PlayerCopy, copyIntKey, PlayerDestroy, freeIntKey, compareIntKey);
+    newSystem->players = IntPlayerMapCreate();
     if(!newSystem->players)
     {
-        mapDestroy(newSystem -> tournaments);
+        IntTournamentMapDestroy(newSystem -> tournaments);
         free(newSystem);
         return NULL;
     }
@@ -50,50 +54,81 @@ void chessDestroy(ChessSystem chess)
 {
     if(!chess) return;
 
-    mapDestroy(chess->tournaments);
-    mapDestroy(chess->players);
+    IntTournamentMapDestroy(chess->tournaments);
+    IntPlayerMapDestroy(chess->players);
     free(chess);
 }
 
-ChessResult chessAddTournament(ChessSystem chess, int tournamentID, int maxGamesPerPlayer, const char* tournamentLocation)
+static void addResult(Player player1, Player player2, int winner)
 {
-    if(!chess || !tournamentLocation)                       return CHESS_NULL_ARGUMENT;
-    else if(tournamentID <= 0)                              return CHESS_INVALID_ID;
-    else if(mapContains(chess->tournaments, &tournamentID)) return CHESS_TOURNAMENT_ALREADY_EXISTS;
-    else if(validName(tournamentLocation) == false)         return CHESS_INVALID_LOCATION;
-    else if(maxGamesPerPlayer <= 0)                         return CHESS_INVALID_MAX_GAMES;
+    switch (winner)
+    {
+        case FIRST_PLAYER:
+            PlayerAddWin(player1);
+            PlayerAddLoss(player2);
+            break;
+        case SECOND_PLAYER:
+            PlayerAddWin(player2);
+            PlayerAddLoss(player1);
+            break;
+        case DRAW:
+            PlayerAddDraw(player1);
+            PlayerAddDraw(player2);
+            break;
+    }
+}
 
-    Tournament newTournament = tournamentCreate(tournamentID, maxGamesPerPlayer, tournamentLocation);
-    if(!newTournament)
+static void removeResult(Player player1, Player player2, int winner)
+{
+    switch (winner)
     {
-        chessDestroy(chess);
-        return CHESS_OUT_OF_MEMORY;
+        case FIRST_PLAYER:
+            PlayerRemoveWin(player1);
+            PlayerRemoveLoss(player2);
+            break;
+        case SECOND_PLAYER:
+            PlayerRemoveWin(player2);
+            PlayerRemoveLoss(player1);
+            break;
+        case DRAW:
+            PlayerRemoveDraw(player1);
+            PlayerRemoveDraw(player2);
+            break;
     }
+}
 
-    if(mapPut(chess->tournaments, &tournamentID, newTournament) == MAP_OUT_OF_MEMORY)
+// a location is a capital letter followed by small letters and spaces
+static bool validName(const char* location)
+{
+    if(location[0] < 'A' || location[0] > 'Z')
+        return false;
+    for(int i = 1; location[i] != '\0'; i++)
     {
-        tournamentDestroy(newTournament);
-        chessDestroy(chess);
-        return CHESS_OUT_OF_MEMORY;
+        if((location[i] < 'a' || location[i] > 'z') && location[i] != ' ')
+            return false;
     }
-    tournamentDestroy(newTournament);
-    return CHESS_SUCCESS;
+    return true;
 }
 
-static ChessResult ChessAddPlayerIfNotInSystem(ChessSystem chess, int playerID)
+ChessResult chessAddTournament(ChessSystem chess, int tournamentID, int maxGamesPerPlayer, const char* tournamentLocation)
 {
-    if(mapGet(chess->players, &playerID) != NULL)
-        return CHESS_SUCCESS;
+    if(!chess || !tournamentLocation)                       return CHESS_NULL_ARGUMENT;
+    else if(tournamentID <= 0)                              return CHESS_INVALID_ID;
+    else if(IntTournamentMapContains(chess->tournaments, tournamentID)) return CHESS_TOURNAMENT_ALREADY_EXISTS;
+    else if(validName(tournamentLocation) == false)         return CHESS_INVALID_LOCATION;
+    else if(maxGamesPerPlayer <= 0)                         return CHESS_INVALID_MAX_GAMES;
 
-    Player newPlayer = PlayerCreate(playerID);
-    if(!newPlayer)
+    Tournament newTournament = TournamentCreate(tournamentID, maxGamesPerPlayer, tournamentLocation);
+    if(!newTournament)
     {
         chessDestroy(chess);
         return CHESS_OUT_OF_MEMORY;
     }
-    if(mapPut(chess->players, &playerID, newPlayer) == MAP_OUT_OF_MEMORY)
+
+    // the map adopts the new tournament, on failure it is still ours to destroy
+    if(IntTournamentMapPut(chess->tournaments, tournamentID, newTournament) == MAP_OUT_OF_MEMORY)
     {
-        PlayerDestroy(newPlayer);
+        TournamentDestroy(newTournament);
         chessDestroy(chess);
         return CHESS_OUT_OF_MEMORY;
     }
@@ -106,20 +141,18 @@ ChessResult chessAddGame(ChessSystem chess, int tournamentID, int firstPlayerID,
         return CHESS_NULL_ARGUMENT;
     if(firstPlayerID == secondPlayerID || tournamentID <= 0 || firstPlayerID <= 0 || secondPlayerID <= 0)
         return CHESS_INVALID_ID;
-    else if(mapContains(chess->tournaments, &tournamentID) == false)
-        return CHESS_TOURNAMENT_NOT_EXIST;
-    else if(playTime < 0)
-        return CHESS_INVALID_PLAY_TIME;
 
-    Tournament currTournament = mapGet(chess->tournaments, &tournamentID);
+    Tournament currTournament = IntTournamentMapGet(chess->tournaments, tournamentID);
     if(!currTournament)
         return CHESS_TOURNAMENT_NOT_EXIST;
-    else if(TournamentHasEnded(currTournament))
+    else if(playTime < 0)
+        return CHESS_INVALID_PLAY_TIME;
+    else if(TournamentHasTournamentEnded(currTournament))
         return CHESS_TOURNAMENT_ENDED;
     else if(TournamentDoesGameExistBetweenPlayers(currTournament, firstPlayerID, secondPlayerID))
     {
-        Player player1 = mapGet(chess->players, &firstPlayerID);
-        Player player2 = mapGet(chess->players, &secondPlayerID);
+        Player player1 = IntPlayerMapGet(chess->players, firstPlayerID);
+        Player player2 = IntPlayerMapGet(chess->players, secondPlayerID);
         assert(player1 != NULL || player2 != NULL);
         // this is because the game already exists, thus, players should be in the system
         bool player1WasDeleted = PlayerIsPlayerDeleted(player1);
@@ -134,42 +167,28 @@ ChessResult chessAddGame(ChessSystem chess, int tournamentID, int firstPlayerID,
     else if(TournamentHasPlayerReachedGamesLimit(currTournament, firstPlayerID)
             || TournamentHasPlayerReachedGamesLimit(currTournament, secondPlayerID))
         return CHESS_EXCEEDED_GAMES;
-    return CHESS_SUCCESS;
 
     // at this point, everything is legal from the tournament's perspective
-    if(TournamentAddGame(currTournament, firstPlayerID, secondPlayerID, winner, playTime) == NULL)
+    if(!TournamentAddGame(currTournament, firstPlayerID, secondPlayerID, winner, playTime))
     {
         chessDestroy(chess);
         return CHESS_OUT_OF_MEMORY;
     }
 
-    ChessResult result = ChessAddPlayerIfNotInSystem(chess, firstPlayerID);
-    if(result != CHESS_SUCCESS)
-        return result;
-    result = ChessAddPlayerIfNotInSystem(chess, secondPlayerID);
-    if(result != CHESS_SUCCESS)
-        return result;
-
-    Player player1 = mapGet(chess->players, &firstPlayerID);
-    Player player2 = mapGet(chess->players, &secondPlayerID);
-    assert  (player1 != NULL && player2 != NULL);
-    PlayerAddPlayTime(player1, playTime);
-    PlayerAddPlayTime(player2, playTime);
-    switch (winner)
+    // players are added to the system by their first game
+    Player player1 = IntPlayerMapGetOrCreate(chess->players, firstPlayerID, PlayerCreate);
+    Player player2 = player1 ? IntPlayerMapGetOrCreate(chess->players, secondPlayerID, PlayerCreate) : NULL;
+    if(!player1 || !player2 || !PlayerAddTournamentGame(player1, tournamentID)
+       || !PlayerAddTournamentGame(player2, tournamentID))
     {
-        case FIRST_PLAYER:
-            PlayerAddWin(player1);
-            PlayerAddLoss(player2);
-            break;
-        case SECOND_PLAYER:
-            PlayerAddWin(player2);
-            PlayerAddLoss(player1);
-            break;
-        case DRAW:
-            PlayerAddDraw(player1);
-            PlayerAddDraw(player2);
-            break;
+        chessDestroy(chess);
+        return CHESS_OUT_OF_MEMORY;
     }
+    PlayerAddGame(player1);
+    PlayerAddGame(player2);
+    PlayerAddPlayTime(player1, playTime);
+    PlayerAddPlayTime(player2, playTime);
+    addResult(player1, player2, winner);
 
     return CHESS_SUCCESS;
 
@@ -180,39 +199,92 @@ ChessResult chessRemoveTournament(ChessSystem chess, int tournamentID)
 {
     if(!chess)                       return CHESS_NULL_ARGUMENT;
     else if(tournamentID <= 0 )      return CHESS_INVALID_ID;
-    else if(mapContains(chess->tournaments, &tournamentID) == false)
+
+    Tournament toDelete = IntTournamentMapGet(chess->tournaments, tournamentID);
+    if(!toDelete)
         return CHESS_TOURNAMENT_NOT_EXIST;
 
-    Tournament toDelete = mapGet(chess->tournaments, &tournamentID);
-    Map gamesList = tournamentGetGamesList(toDelete);
-    MAP_FOREACH(const char*, currentGameKey, gamesList)
+    int* playerIDs = malloc((TournamentGetNumOfPlayers(toDelete) + 1) * sizeof(*playerIDs));
+    if(!playerIDs)
     {
-        Game game = mapGet(gamesList, (MapKeyElement) currentGameKey);
-        int firstPlayerID = GameGetPlayer1ID(game);
-        int secondPlayerID = GameGetPlayer2ID(game);
-        Player player1 = mapGet(chess->players, &firstPlayerID);
-        Player player2 = mapGet(chess->players, &secondPlayerID);
-        assert(player1 != NULL || player2 != NULL);
-        PlayerAddPlayTime(player1, -GameGetPlayTime(game));
-        PlayerAddPlayTime(player2, -GameGetPlayTime(game));
-        switch (GameGetWinner(game))
+        chessDestroy(chess);
+        return CHESS_OUT_OF_MEMORY;
+    }
+
+    // every player's results in the tournament are taken back at once, not game by game
+    int playersCount = TournamentGetPlayers(toDelete, playerIDs);
+    for(int i = 0; i < playersCount; i++)
+    {
+        int games, wins, losses, draws, playTime;
+        TournamentGetPlayerResults(toDelete, playerIDs[i], &games, &wins, &losses, &draws, &playTime);
+        Player player = IntPlayerMapGet(chess->players, playerIDs[i]);
+        assert(player != NULL);
+        PlayerRemoveResults(player, games, wins, losses, draws);
+        PlayerAddPlayTime(player, -playTime);
+        PlayerRemoveTournament(player, tournamentID);
+    }
+    free(playerIDs);
+    IntTournamentMapRemove(chess->tournaments, tournamentID);
+    return CHESS_SUCCESS;
+}
+
+ChessResult chessRemovePlayer(ChessSystem chess, int playerID)
+{
+    if(!chess)                  return CHESS_NULL_ARGUMENT;
+    else if(playerID <= 0)      return CHESS_INVALID_ID;
+
+    Player player = IntPlayerMapGet(chess->players, playerID);
+    if(!player || PlayerIsPlayerDeleted(player))
+        return CHESS_PLAYER_NOT_EXIST;
+
+    // only the player's tournaments, and in them only the player's games, are visited
+    for(int i = 0; i < PlayerGetNumOfTournaments(player); i++)
+    {
+        Tournament tournament = IntTournamentMapGet(chess->tournaments, PlayerGetTournamentID(player, i));
+        if(TournamentHasTournamentEnded(tournament))
+            continue;
+        for(int game = TournamentGetPlayerLastGame(tournament, playerID); game != -1;
+            game = TournamentGetPlayerPreviousGame(tournament, playerID, game))
         {
-            case FIRST_PLAYER:
-                PlayerRemoveWin(player1);
-                PlayerRemoveLoss(player2);
-                break;
-            case SECOND_PLAYER:
-                PlayerRemoveWin(player2);
-                PlayerRemoveLoss(player1);
-                break;
-            case DRAW:
-                PlayerRemoveDraw(player1);
-                PlayerRemoveDraw(player2);
-                break;
+            int player1ID, player2ID, winner, playTime;
+            TournamentGetGame(tournament, game, &player1ID, &player2ID, &winner, &playTime);
+            bool isFirst = player1ID == playerID;
+            Player opponent = IntPlayerMapGet(chess->players, isFirst ? player2ID : player1ID);
+            // a game whose both players were removed stays as it is
+            if(PlayerIsPlayerDeleted(opponent))
+                continue;
+
+            int opponentWins = isFirst ? SECOND_PLAYER : FIRST_PLAYER;
+            if(!TournamentSetGameWinner(tournament, game, opponentWins))
+            {
+                chessDestroy(chess);
+                return CHESS_OUT_OF_MEMORY;
+            }
+            Player player1 = isFirst ? player : opponent;
+            Player player2 = isFirst ? opponent : player;
+            removeResult(player1, player2, winner);
+            addResult(player1, player2, opponentWins);
         }
-        freeChar((MapKeyElement) currentGameKey);
+        TournamentRemovePlayer(tournament, playerID);
     }
-    mapRemove(chess->tournaments, &tournamentID);
+    PlayerRemovePlayer(player);
+    return CHESS_SUCCESS;
+}
+
+ChessResult chessEndTournament(ChessSystem chess, int tournamentID)
+{
+    if(!chess)                      return CHESS_NULL_ARGUMENT;
+    else if(tournamentID <= 0)      return CHESS_INVALID_ID;
+
+    Tournament tournament = IntTournamentMapGet(chess->tournaments, tournamentID);
+    if(!tournament)
+        return CHESS_TOURNAMENT_NOT_EXIST;
+    else if(TournamentHasTournamentEnded(tournament))
+        return CHESS_TOURNAMENT_ENDED;
+    else if(TournamentGetNumOfGames(tournament) == 0)
+        return CHESS_NO_GAMES;
+
+    TournamentEndTournament(tournament);
     return CHESS_SUCCESS;
 }
 
@@ -228,40 +300,102 @@ double chessCalculateAveragePlayTime(ChessSystem chess, int playerID, ChessResul
         return 0;
     }
 
-    Player currPlayer = mapGet(chess->players,&playerID);
-    if(!currPlayer || GetPlayerStatus(currPlayer) == DELETED)
+    Player currPlayer = IntPlayerMapGet(chess->players, playerID);
+    if(!currPlayer || PlayerIsPlayerDeleted(currPlayer))
     {
         *ChessResult= CHESS_PLAYER_NOT_EXIST;
         return 0;
     }
-    double result = (double)(PlayerGetTotalPlayTime(currPlayer)) / PlayerGetNumOfPlayedGames(currPlayer);
+    // the games of a player may all have been removed with their tournaments
+    int playedGames = PlayerGetNumOfPlayedGames(currPlayer);
+    double result = playedGames == 0 ? 0 : (double)(PlayerGetTotalPlayTime(currPlayer)) / playedGames;
     *ChessResult = CHESS_SUCCESS;
     return result;
 }
 
 static double calculatePlayerLevel(Player player)
 {
-    double sum = (PlayergetWinsNum(player)*WINS_FACTOR) - (PlayergetLossesNum(player)*LOSSES_FACTOR)
-            + (PlayergetDrawsNum(player)*DRAWS_FACTOR);
+    double sum = (PlayerGetWinsNum(player)*WINS_FACTOR) - (PlayerGetLossesNum(player)*LOSSES_FACTOR)
+            + (PlayerGetDrawsNum(player)*DRAWS_FACTOR);
     return sum / (double) PlayerGetNumOfPlayedGames(player) ;
 }
 
+typedef struct player_level_t
+{
+    int playerID;
+    double level;
+} PlayerLevel;
+
+// higher levels first, equal levels by increasing ID
+static int comparePlayerLevels(const void* first, const void* second)
+{
+    const PlayerLevel* level1 = first;
+    const PlayerLevel* level2 = second;
+    if(level1->level != level2->level)
+        return level1->level < level2->level ? 1 : -1;
+    return level1->playerID - level2->playerID;
+}
+
 ChessResult chessSavePlayersLevels(ChessSystem chess, FILE* file)
 {
     if(!chess || !file) return CHESS_NULL_ARGUMENT;
 
-    int maxLevelID = mapGetFirst(chess->players);
-    int maxLevel = calculatePlayerLevel(mapGet(maxLevelID));
-    MAP_FOREACH(int*, playerID, chess->players)
+    PlayerLevel* levels = malloc((IntPlayerMapGetSize(chess->players) + 1) * sizeof(*levels));
+    if(!levels)
+    {
+        chessDestroy(chess);
+        return CHESS_OUT_OF_MEMORY;
+    }
+
+    int levelsCount = 0;
+    MAP_FOREACH_TYPED(IntPlayerMap, cursor, chess->players)
     {
-        Player player = mapGet(chess->players, playerID);
-        if (PlayerGetPlayingStatus(player) != true || PlayerGetNumOfPlayedGames(player) == 0)
+        Player player = IntPlayerMapCursorValue(&cursor);
+        if (PlayerIsPlayerDeleted(player) || PlayerGetNumOfPlayedGames(player) == 0)
             continue;
-        int tempLevel = calculatePlayerLevel(player);
-        maxLevel = tempLevel > maxLevel ? tempLevel : maxLevel;
-        maxLevelID = tempLevel > maxLevel > *playerID : maxLevelID;
-        freeIntKey(playerID);
+        levels[levelsCount].playerID = IntPlayerMapCursorKey(&cursor);
+        levels[levelsCount].level = calculatePlayerLevel(player);
+        levelsCount++;
     }
-    fprintf(file, "%d %.2f\n", maxLevelID, maxLevel);
-    return CHESS_SUCCESS;
-}
\ No newline at end of file
+    qsort(levels, levelsCount, sizeof(*levels), comparePlayerLevels);
+
+    ChessResult result = CHESS_SUCCESS;
+    for(int i = 0; i < levelsCount && result == CHESS_SUCCESS; i++)
+    {
+        if(fprintf(file, "%d %.2f\n", levels[i].playerID, levels[i].level) < 0)
+            result = CHESS_SAVE_FAILURE;
+    }
+    free(levels);
+    return result;
+}
+
+ChessResult chessSaveTournamentStatistics(ChessSystem chess, char* pathFile)
+{
+    if(!chess || !pathFile) return CHESS_NULL_ARGUMENT;
+
+    FILE* file = fopen(pathFile, "w");
+    if(!file)
+        return CHESS_SAVE_FAILURE;
+
+    // the statistics are kept by the tournaments, nothing is recomputed from the games
+    int endedCount = 0;
+    bool printed = true;
+    MAP_FOREACH_TYPED(IntTournamentMap, cursor, chess->tournaments)
+    {
+        Tournament tournament = IntTournamentMapCursorValue(&cursor);
+        if(!TournamentHasTournamentEnded(tournament))
+            continue;
+        endedCount++;
+        TournamentStats stats = TournamentGetStats(tournament);
+        printed = printed && fprintf(file, "%d\n%d\n%.2f\n%s\n%d\n%d\n", TournamentGetWinnerID(tournament),
+                                     stats.maxPlayTime, (double) stats.totalPlayTime / stats.gamesCount,
+                                     TournamentGetLocation(tournament), stats.gamesCount,
+                                     TournamentGetNumOfPlayers(tournament)) >= 0;
+    }
+    if(fclose(file) != 0)
+        printed = false;
+
+    if(endedCount == 0)
+        return CHESS_NO_TOURNAMENTS_ENDED;
+    return printed ? CHESS_SUCCESS : CHESS_SAVE_FAILURE;
+}
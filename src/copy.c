@@ -513,20 +513,24 @@ ChessResult chessRemovePlayer(ChessSystem chess, int player_id)
 
 static int getMax(Map curr_players)
 {
-    int* firstkey = mapGetFirst(curr_players);
-    double* max_level = mapGet(curr_players, firstkey);
-    freeIntKey(firstkey);
+    MapCursor first;
+    mapCursorFirst(curr_players, &first);
+    double max_level = *(double*) mapCursorGetData(&first);
 
-    MAP_FOREACH(int*, curr_player_id, curr_players)
+    MAP_FOREACH_CURSOR(int*, curr_player_id, cursor, curr_players)
     {
-        double* level = mapGet(curr_players, curr_player_id);
-        if(*level > *max_level)
+        double* level = mapCursorGetData(&cursor);
+        if(*level > max_level)
         {
-            *max_level = *level;
+            max_level = *level;
         }
-        freeIntKey(curr_player_id);
     }
-    return *max_level;
+    return max_level;
+}
+
+static int compareIds(const void* id1, const void* id2)
+{
+    return *(const int*) id1 - *(const int*) id2;
 }
 
 static double calculatePoints(Player player)
@@ -564,38 +568,69 @@ ChessResult chessEndTournament(ChessSystem chess, int tournament_id)
         return CHESS_NO_GAMES;
     }
 
-    Map players_in_tournament = mapCreate(copyPlayerData, copyIntkey, freePlayerData, freeIntKey, Intkeycompare);
+    // every game has two players, so there are at most twice as many players as games
+    int games_count = mapGetSize(games_list);
+    int* players_ids = malloc(2 * games_count * sizeof(int));
+    MapKeyElement* ids_keys = malloc(2 * games_count * sizeof(MapKeyElement));
+    MapDataElement* players_data = malloc(2 * games_count * sizeof(MapDataElement));
+    double* players_points_data = malloc(2 * games_count * sizeof(double));
+    if(players_ids == NULL || ids_keys == NULL || players_data == NULL || players_points_data == NULL)
+    {
+        free(players_ids);
+        free(ids_keys);
+        free(players_data);
+        free(players_points_data);
+        return CHESS_OUT_OF_MEMORY;
+    }
+
+    int ids_count = 0;
+    MAP_FOREACH_CURSOR(char*, curr_game, games_cursor, games_list)
+    {
+        Game game = mapCursorGetData(&games_cursor);
+        players_ids[ids_count++] = GameGetPlayer1ID(game);
+        players_ids[ids_count++] = GameGetPlayer2ID(game);
+    }
 
-    MAP_FOREACH(char*, curr_game, games_list)
+    // sorted and without duplicates, the maps of the tournament's players are built at once
+    qsort(players_ids, ids_count, sizeof(int), compareIds);
+    int players_count = 0;
+    for(int i = 0; i < ids_count; i++)
     {
-        Game game = mapGet(games_list, (MapKeyElement) curr_game);
-        int player1_id = GameGetPlayer1ID(game);
-        int player2_id = GameGetPlayer2ID(game);
-        Player player1 = playerCreate(player1_id);
-        Player player2 = playerCreate(player2_id);
-        if( !mapContains(players_in_tournament, &player1_id) )
-        {
-            mapPut(players_in_tournament, &player1_id, player1);
-        }
-        if( !mapContains(players_in_tournament, &player2_id) )
+        if(players_count > 0 && players_ids[players_count - 1] == players_ids[i])
         {
-            mapPut(players_in_tournament, &player2_id, player2);
+            continue;
         }
-        playerDestroy(player1);
-        playerDestroy(player2);
-        freeChar(curr_game);
+        players_ids[players_count] = players_ids[i];
+        ids_keys[players_count] = &players_ids[players_count];
+        players_data[players_count] = playerCreate(players_ids[i]);
+        players_count++;
+    }
+
+    Map players_in_tournament = mapCreateFromSorted(copyPlayerData, copyIntkey, freePlayerData, freeIntKey,
+                                                    Intkeycompare, ids_keys, players_data, players_count);
+    for(int i = 0; i < players_count; i++)
+    {
+        playerDestroy(players_data[i]);
+    }
+    if(players_in_tournament == NULL)
+    {
+        free(players_ids);
+        free(ids_keys);
+        free(players_data);
+        free(players_points_data);
+        return CHESS_OUT_OF_MEMORY;
     }
 
-    MAP_FOREACH( char*, curr_game, games_list)
+    MAP_FOREACH_CURSOR(char*, curr_game, games_cursor, games_list)
     {
-        Game game = mapGet(games_list, (MapKeyElement) curr_game);
+        Game game = mapCursorGetData(&games_cursor);
         int player1_id = GameGetPlayer1ID(game);
         int player2_id = GameGetPlayer2ID(game);
+        MapKeyElement players_keys[2] = { &player1_id, &player2_id };
+        MapDataElement players[2];
+        mapGetMany(players_in_tournament, players_keys, 2, players);
         INFO status = ADD;
-        updatePlayersInfo(mapGet(players_in_tournament, &player1_id),
-             mapGet(players_in_tournament, &player2_id), GameGetWinner(game),
-              GameGetPlayTime(game), status);
-        freeChar(curr_game);
+        updatePlayersInfo(players[0], players[1], GameGetWinner(game), GameGetPlayTime(game), status);
     }
 
     MAP_FOREACH(int*, player_id, chess->players)
@@ -609,29 +644,41 @@ ChessResult chessEndTournament(ChessSystem chess, int tournament_id)
         freeIntKey(player_id);
     }
 
-    Map players_points = mapCreate(copyDoubleData, copyIntkey, freeDoubleData, freeIntKey, Intkeycompare);
-
-    MAP_FOREACH(int*, curr_player_id, players_in_tournament)
+    // players_in_tournament holds exactly the IDs of ids_keys, in the same order
+    for(int i = 0; i < players_count; i++)
     {
-        Player player = mapGet(players_in_tournament, curr_player_id);
-        double points = calculatePoints(player);
-        mapPut(players_points, curr_player_id, &points);
-        freeIntKey( (MapKeyElement) curr_player_id);
+        players_points_data[i] = calculatePoints(mapGet(players_in_tournament, ids_keys[i]));
+        players_data[i] = &players_points_data[i];
+    }
+    Map players_points = mapCreateFromSorted(copyDoubleData, copyIntkey, freeDoubleData, freeIntKey,
+                                             Intkeycompare, ids_keys, players_data, players_count);
+    free(players_ids);
+    free(ids_keys);
+    free(players_data);
+    free(players_points_data);
+    if(players_points == NULL)
+    {
+        mapDestroy(players_in_tournament);
+        return CHESS_OUT_OF_MEMORY;
     }
 
     double max_level = getMax(players_points);
 
-    MAP_FOREACH(int*, curr_player_id, players_points)
+    // players below the best level cannot win, they are removed without breaking the walk
+    MAP_FOREACH_CURSOR(int*, curr_player_id, points_cursor, players_points)
     {
-        double* curr_player_level = mapGet(players_points, curr_player_id);
+        double* curr_player_level = mapCursorGetData(&points_cursor);
         Player player = mapGet(players_in_tournament, curr_player_id);
         if( max_level > *curr_player_level && GetPlayerStatus(player) != DELETED)
         {
-            // mapRemove(players_points, curr_player_id);
             SetPlayerStatus(player, DELETED);
-
+            if(mapCursorRemove(&points_cursor) == MAP_OUT_OF_MEMORY)
+            {
+                mapDestroy(players_points);
+                mapDestroy(players_in_tournament);
+                return CHESS_OUT_OF_MEMORY;
+            }
         }
-        freeIntKey(curr_player_id);
     }
 
     if(mapGetSize(players_points) <= 1)
@@ -792,42 +839,51 @@ ChessResult chessSavePlayersLevels(ChessSystem chess, FILE* file)
         return CHESS_NULL_ARGUMENT;
     }
 
-    Map players_copy = mapCreate(copyPlayerData, copyIntkey,
-                                 freePlayerData, freeIntKey, Intkeycompare);
-    MAP_FOREACH(int*, curr_player, chess->players)
+    int players_number = mapGetSize(chess->players);
+    MapKeyElement* players_keys = malloc((players_number + 1) * sizeof(MapKeyElement));
+    MapDataElement* players_data = malloc((players_number + 1) * sizeof(MapDataElement));
+    if(players_keys == NULL || players_data == NULL)
     {
-        Player player = mapGet(chess->players, curr_player);
+        free(players_keys);
+        free(players_data);
+        return CHESS_OUT_OF_MEMORY;
+    }
+
+    // the cursor walks the players by increasing ID, so the copy is built from sorted keys at once
+    int players_count = 0;
+    MAP_FOREACH_CURSOR(int*, curr_player, cursor, chess->players)
+    {
+        Player player = mapCursorGetData(&cursor);
         if ( GetPlayerStatus(player) == STILL_IN && PlayergetNumOfGames(player) != 0)
         {
-            mapPut(players_copy,curr_player,player);
+            players_keys[players_count] = curr_player;
+            players_data[players_count] = player;
+            players_count++;
         }
-        freeIntKey( (MapKeyElement) curr_player);
+    }
+    Map players_copy = mapCreateFromSorted(copyPlayerData, copyIntkey, freePlayerData, freeIntKey,
+                                           Intkeycompare, players_keys, players_data, players_count);
+    free(players_keys);
+    free(players_data);
+    if(players_copy == NULL)
+    {
+        return CHESS_OUT_OF_MEMORY;
     }
 
     while(mapGetSize(players_copy)> 0)
     {
-        int* firstkey = mapGetFirst(players_copy);
-        Player player = mapGet(players_copy, firstkey);
-        double level = calculateLevel(player);
-        double max_level = level;
-        int max_level_id = *firstkey;
-        freeIntKey(firstkey);
+        MapCursor first;
+        int max_level_id = *(int*) mapCursorFirst(players_copy, &first);
+        double max_level = calculateLevel(mapCursorGetData(&first));
 
-        MAP_FOREACH(int*, curr_player, players_copy)
+        MAP_FOREACH_CURSOR(int*, curr_player, cursor, players_copy)
         {
-            if(mapGetSize(players_copy) == 1)
-            {
-                freeIntKey(curr_player);
-                break;
-            }
-            player = mapGet(players_copy, curr_player);
-            level = calculateLevel(player);
+            double level = calculateLevel(mapCursorGetData(&cursor));
             if(level > max_level )
             {
                 max_level = level;
                 max_level_id = *curr_player;
             }
-            freeIntKey(curr_player);
         }
         fprintf(file, "%d %.2f\n", max_level_id, max_level);
         mapRemove(players_copy, &max_level_id);
@@ -837,6 +893,24 @@ ChessResult chessSavePlayersLevels(ChessSystem chess, FILE* file)
 }
 
 // CALCULATE AND SAVE STATISTICS OF TOURNAMENTS THAT HAVE ENDED
+#define STATISTICS_THREADS 4
+
+typedef struct participants_count_t {
+    int tournament_id;
+    int num_of_players;
+} ParticipantsCount;
+
+// runs on the players of one range of chess->players, only this thread touches their tournaments lists
+static void countParticipations(MapKeyElement player_id, MapDataElement player, void* accumulator)
+{
+    ParticipantsCount* count = accumulator;
+    int* num_of_adds = mapPeek(playerGetTournamentsList(player), &count->tournament_id);
+    if(num_of_adds != NULL)
+    {
+        count->num_of_players += *num_of_adds;
+    }
+    (void) player_id;
+}
 ChessResult chessSaveTournamentStatistics (ChessSystem chess, char* path_file)
     {
     if(chess==NULL)
@@ -867,20 +941,25 @@ ChessResult chessSaveTournamentStatistics (ChessSystem chess, char* path_file)
             fprintf(file,"%.2f\n", avg);
             fprintf(file,"%s\n",  tournamentGetlocation(tournament));
             fprintf(file,"%d\n", (int) num_of_games);
+            // every thread counts the players of its range, the counts are summed up afterwards
+            ParticipantsCount counts[STATISTICS_THREADS];
+            void* accumulators[STATISTICS_THREADS];
+            for(int i = 0; i < STATISTICS_THREADS; i++)
+            {
+                counts[i].tournament_id = *curr_tournament;
+                counts[i].num_of_players = 0;
+                accumulators[i] = &counts[i];
+            }
+            if(mapParallelForEach(chess->players, STATISTICS_THREADS, countParticipations, accumulators) != MAP_SUCCESS)
+            {
+                freeIntKey(curr_tournament);
+                fclose(file);
+                return CHESS_OUT_OF_MEMORY;
+            }
             int num_of_players_in_tournament = 0;
-            MAP_FOREACH(int*, curr_player, chess->players)
+            for(int i = 0; i < STATISTICS_THREADS; i++)
             {
-                Player player = mapGet(chess->players, curr_player);
-                MAP_FOREACH(int*, curr_player_tournament, playerGetTournamentsList(player))
-                {
-                    if(*curr_player_tournament == *curr_tournament)
-                    {
-                         int* num_of_adds = mapGet(playerGetTournamentsList(player), curr_player_tournament);
-                         num_of_players_in_tournament += *num_of_adds;
-                    }
-                    freeIntKey(curr_player_tournament);
-                }
-                freeIntKey(curr_player);
+                num_of_players_in_tournament += counts[i].num_of_players;
             }
             fprintf(file, "%d\n", num_of_players_in_tournament);
         }
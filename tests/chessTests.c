@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "test_utilities.h"
+// the system is compiled in, so the tests can look at the games kept by its tournaments
+#include "../src/chessSystem.c"
+
+#define STATISTICS_FILE "chessTestsStatistics.txt"
+#define OUTPUT_SIZE 256
+
+static ChessSystem createWithTournaments(int count)
+{
+    ChessSystem chess = chessCreate();
+    for(int id = 1; chess != NULL && id <= count; id++)
+    {
+        if(chessAddTournament(chess, id, 10, "London") != CHESS_SUCCESS)
+        {
+            chessDestroy(chess);
+            return NULL;
+        }
+    }
+    return chess;
+}
+
+static int endAndGetWinner(ChessSystem chess, int tournamentID)
+{
+    if(chessEndTournament(chess, tournamentID) != CHESS_SUCCESS)
+        return -1;
+    return TournamentGetWinnerID(IntTournamentMapGet(chess->tournaments, tournamentID));
+}
+
+// reads back all that was written to a file, which is then closed
+static bool readAll(FILE* file, char* buffer)
+{
+    rewind(file);
+    size_t length = fread(buffer, 1, OUTPUT_SIZE - 1, file);
+    buffer[length] = '\0';
+    return fclose(file) == 0;
+}
+
+static bool savedLevelsAre(ChessSystem chess, const char* expected)
+{
+    char output[OUTPUT_SIZE];
+    FILE* file = tmpfile();
+    ASSERT_TEST(file != NULL);
+    ASSERT_TEST(chessSavePlayersLevels(chess, file) == CHESS_SUCCESS);
+    ASSERT_TEST(readAll(file, output));
+    ASSERT_TEST(strcmp(output, expected) == 0);
+    return true;
+}
+
+static bool testWinnerByScore()
+{
+    ChessSystem chess = createWithTournaments(1);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 3, 4, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(endAndGetWinner(chess, 1) == 3);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testWinnerByLossesThenID()
+{
+    ChessSystem chess = createWithTournaments(1);
+    ASSERT_TEST(chess != NULL);
+    // 1, 2 and 3 beat each other in turn, 4 draws with 5 and 6: all score 1, only 4, 5 and 6 never lost
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 2, 3, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 3, 1, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 6, 4, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 5, 4, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(endAndGetWinner(chess, 1) == 4);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testWinnerByWins()
+{
+    ChessSystem chess = createWithTournaments(1);
+    ASSERT_TEST(chess != NULL);
+    // 1 and 2 both won all their games and never lost, 2 won more of them
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 10, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 2, 11, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 12, 2, SECOND_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(endAndGetWinner(chess, 1) == 2);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testRemovePlayerAwardsOpponent()
+{
+    ChessSystem chess = createWithTournaments(2);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 2, 1, SECOND_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessEndTournament(chess, 2) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemovePlayer(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemovePlayer(chess, 1) == CHESS_PLAYER_NOT_EXIST);
+    // only the game of the tournament that did not end goes to 2
+    ASSERT_TEST(savedLevelsAre(chess, "2 -2.00\n"));
+    ASSERT_TEST(endAndGetWinner(chess, 1) == 2);
+    ASSERT_TEST(TournamentGetWinnerID(IntTournamentMapGet(chess->tournaments, 2)) == 1);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testGameOfRemovedPlayersUnchanged()
+{
+    ChessSystem chess = createWithTournaments(1);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 3, 2, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemovePlayer(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemovePlayer(chess, 2) == CHESS_SUCCESS);
+
+    int player1ID, player2ID, winner, playTime;
+    Tournament tournament = IntTournamentMapGet(chess->tournaments, 1);
+    TournamentGetGame(tournament, 0, &player1ID, &player2ID, &winner, &playTime);
+    ASSERT_TEST(player1ID == 1 && player2ID == 2 && winner == SECOND_PLAYER);
+    TournamentGetGame(tournament, 1, &player1ID, &player2ID, &winner, &playTime);
+    ASSERT_TEST(player1ID == 3 && player2ID == 2 && winner == FIRST_PLAYER);
+    ASSERT_TEST(savedLevelsAre(chess, "3 6.00\n"));
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testRemoveTournamentRestoresPlayers()
+{
+    ChessSystem chess = createWithTournaments(2);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 1, 2, SECOND_PLAYER, 30) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 1, 3, DRAW, 50) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveTournament(chess, 2) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveTournament(chess, 2) == CHESS_TOURNAMENT_NOT_EXIST);
+
+    ChessResult result;
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 1, &result) == 10 && result == CHESS_SUCCESS);
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 3, &result) == 0 && result == CHESS_SUCCESS);
+    ASSERT_TEST(savedLevelsAre(chess, "1 6.00\n2 -10.00\n"));
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testAveragePlayTime()
+{
+    ChessSystem chess = createWithTournaments(2);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 3, DRAW, 20) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 2, 1, DRAW, 7) == CHESS_SUCCESS);
+
+    ChessResult result;
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 1, &result) == 37 / 3.0 && result == CHESS_SUCCESS);
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 2, &result) == 8.5 && result == CHESS_SUCCESS);
+    chessCalculateAveragePlayTime(chess, 4, &result);
+    ASSERT_TEST(result == CHESS_PLAYER_NOT_EXIST);
+    chessCalculateAveragePlayTime(chess, 0, &result);
+    ASSERT_TEST(result == CHESS_INVALID_ID);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testSaveTournamentStatistics()
+{
+    ChessSystem chess = createWithTournaments(3);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(chessSaveTournamentStatistics(chess, STATISTICS_FILE) == CHESS_NO_TOURNAMENTS_ENDED);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 3, 2, SECOND_PLAYER, 25) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 4, 5, DRAW, 6) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 3, 6, 7, DRAW, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessEndTournament(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessEndTournament(chess, 1) == CHESS_TOURNAMENT_ENDED);
+    ASSERT_TEST(chessEndTournament(chess, 2) == CHESS_SUCCESS);
+    // tournament 3 did not end and is left out
+    ASSERT_TEST(chessSaveTournamentStatistics(chess, STATISTICS_FILE) == CHESS_SUCCESS);
+
+    char output[OUTPUT_SIZE];
+    FILE* file = fopen(STATISTICS_FILE, "r");
+    ASSERT_TEST(file != NULL);
+    ASSERT_TEST(readAll(file, output));
+    remove(STATISTICS_FILE);
+    ASSERT_TEST(strcmp(output, "1\n25\n17.50\nLondon\n2\n3\n4\n6\n6.00\nLondon\n1\n2\n") == 0);
+    chessDestroy(chess);
+    return true;
+}
+
+static bool testSavePlayersLevels()
+{
+    ChessSystem chess = createWithTournaments(1);
+    ASSERT_TEST(chess != NULL);
+    ASSERT_TEST(savedLevelsAre(chess, ""));
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 3, 2, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 4, 5, DRAW, 10) == CHESS_SUCCESS);
+    // equal levels are written by increasing ID
+    ASSERT_TEST(savedLevelsAre(chess, "1 6.00\n3 2.00\n4 2.00\n5 2.00\n2 -4.00\n"));
+    ASSERT_TEST(chessSavePlayersLevels(chess, NULL) == CHESS_NULL_ARGUMENT);
+    chessDestroy(chess);
+    return true;
+}
+
+int main()
+{
+    int failed = 0;
+    RUN_TEST(testWinnerByScore, "testWinnerByScore", failed);
+    RUN_TEST(testWinnerByLossesThenID, "testWinnerByLossesThenID", failed);
+    RUN_TEST(testWinnerByWins, "testWinnerByWins", failed);
+    RUN_TEST(testRemovePlayerAwardsOpponent, "testRemovePlayerAwardsOpponent", failed);
+    RUN_TEST(testGameOfRemovedPlayersUnchanged, "testGameOfRemovedPlayersUnchanged", failed);
+    RUN_TEST(testRemoveTournamentRestoresPlayers, "testRemoveTournamentRestoresPlayers", failed);
+    RUN_TEST(testAveragePlayTime, "testAveragePlayTime", failed);
+    RUN_TEST(testSaveTournamentStatistics, "testSaveTournamentStatistics", failed);
+    RUN_TEST(testSavePlayersLevels, "testSavePlayersLevels", failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,467 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "test_utilities.h"
+#include "../lib/Map.h"
+
+static void* copyInt(void* element)
+{
+    int* copy = malloc(sizeof(*copy));
+    if(copy != NULL)
+        *copy = *(int*) element;
+    return copy;
+}
+
+static void freeInt(void* element) { free(element); }
+static int compareInts(void* first, void* second) { return *(int*) first - *(int*) second; }
+static unsigned int hashInt(void* element) { return (unsigned int) *(int*) element; }
+
+static Map createIntMap(bool hashed)
+{
+    return hashed ? mapCreateHashed(copyInt, copyInt, freeInt, freeInt, compareInts, hashInt)
+                  : mapCreate(copyInt, copyInt, freeInt, freeInt, compareInts);
+}
+
+static bool testGetManyEmptyHashed()
+{
+    Map map = createIntMap(true);
+    ASSERT_TEST(map != NULL);
+    int ids[3] = { 1, 2, 3 };
+    MapKeyElement keys[3] = { &ids[0], &ids[1], &ids[2] };
+    MapDataElement data[3] = { &ids[0], &ids[1], &ids[2] };
+    ASSERT_TEST(mapGetMany(map, keys, 3, data) == MAP_SUCCESS);
+    ASSERT_TEST(data[0] == NULL && data[1] == NULL && data[2] == NULL);
+    mapDestroy(map);
+    return true;
+}
+
+static bool testGetMany()
+{
+    for(int hashed = 0; hashed <= 1; hashed++)
+    {
+        Map map = createIntMap(hashed);
+        ASSERT_TEST(map != NULL);
+        for(int i = 0; i < 100; i += 2)
+            ASSERT_TEST(mapPut(map, &i, &i) == MAP_SUCCESS);
+        int ids[20];
+        MapKeyElement keys[20];
+        MapDataElement data[20];
+        for(int i = 0; i < 20; i++)
+        {
+            ids[i] = i * 5;
+            keys[i] = &ids[i];
+        }
+        ASSERT_TEST(mapGetMany(map, keys, 20, data) == MAP_SUCCESS);
+        for(int i = 0; i < 20; i++)
+            ASSERT_TEST(ids[i] % 2 == 0 ? data[i] != NULL && *(int*) data[i] == ids[i] : data[i] == NULL);
+        mapDestroy(map);
+    }
+    return true;
+}
+
+#define THREADS_KEYS 10000
+
+// builds and tears down a map of its own, its nodes come from the pools every thread shares
+static void* useOwnMap(void* result)
+{
+    bool* success = result;
+    Map map = createIntMap(false);
+    *success = map != NULL;
+    for(int i = 0; i < THREADS_KEYS && *success; i++)
+        *success = mapPut(map, &i, &i) == MAP_SUCCESS;
+    for(int i = 0; i < THREADS_KEYS && *success; i += 2)
+        *success = mapRemove(map, &i) == MAP_SUCCESS;
+    *success = *success && mapGetSize(map) == THREADS_KEYS / 2;
+    mapDestroy(map);
+    return NULL;
+}
+
+static bool testSeparateMapsOnThreads()
+{
+    pthread_t other;
+    bool otherSuccess = false, ownSuccess = false;
+    ASSERT_TEST(pthread_create(&other, NULL, useOwnMap, &otherSuccess) == 0);
+    useOwnMap(&ownSuccess);
+    pthread_join(other, NULL);
+    ASSERT_TEST(ownSuccess && otherSuccess);
+    return true;
+}
+
+#define PARALLEL_THREADS 4
+#define PARALLEL_KEYS 1000
+
+typedef struct peek_sum_t {
+    Map lookup;
+    long sum;
+} PeekSum;
+
+// looks every key up in another map, which shares its nodes with a copy
+static void addPeeked(MapKeyElement key, MapDataElement data, void* accumulator)
+{
+    PeekSum* peekSum = accumulator;
+    int* value = mapPeek(peekSum->lookup, key);
+    if(value != NULL)
+        peekSum->sum += *value;
+    (void) data;
+}
+
+static bool testParallelForEachOnSharedMaps()
+{
+    for(int hashed = 0; hashed <= 1; hashed++)
+    {
+        Map map = createIntMap(hashed);
+        Map lookup = createIntMap(hashed);
+        ASSERT_TEST(map != NULL && lookup != NULL);
+        for(int i = 0; i < PARALLEL_KEYS; i++)
+        {
+            ASSERT_TEST(mapPut(map, &i, &i) == MAP_SUCCESS);
+            ASSERT_TEST(mapPut(lookup, &i, &i) == MAP_SUCCESS);
+        }
+        Map mapCopied = mapCopy(map);
+        Map lookupCopied = mapCopy(lookup);
+        ASSERT_TEST(mapCopied != NULL && lookupCopied != NULL);
+
+        PeekSum sums[PARALLEL_THREADS];
+        void* accumulators[PARALLEL_THREADS];
+        for(int i = 0; i < PARALLEL_THREADS; i++)
+        {
+            sums[i].lookup = lookup;
+            sums[i].sum = 0;
+            accumulators[i] = &sums[i];
+        }
+        ASSERT_TEST(mapParallelForEach(map, PARALLEL_THREADS, addPeeked, accumulators) == MAP_SUCCESS);
+        long total = 0;
+        for(int i = 0; i < PARALLEL_THREADS; i++)
+            total += sums[i].sum;
+        ASSERT_TEST(total == (long) PARALLEL_KEYS * (PARALLEL_KEYS - 1) / 2);
+
+        mapDestroy(map);
+        mapDestroy(lookup);
+        mapDestroy(mapCopied);
+        mapDestroy(lookupCopied);
+    }
+    return true;
+}
+
+#define RANDOM_SEED 20240611u
+#define RANDOM_OPERATIONS 200000
+#define RANDOM_KEYS 3000
+#define RANDOM_PHASE 25000
+#define RANDOM_CHECK_EVERY 5000
+#define RANDOM_BATCH 400
+#define RANDOM_RANGE 64
+#define RANDOM_MODELS 3
+#define RANDOM_COPY_MODEL 2
+
+// a map next to a plain array of what it should hold, indexed by key
+typedef struct model_t {
+    Map map;
+    int values[RANDOM_KEYS];
+    bool present[RANDOM_KEYS];
+    int size;
+} Model;
+
+static Model models[RANDOM_MODELS];
+static unsigned int randomState = RANDOM_SEED;
+
+// xorshift, so the sequence of operations is the same on every platform
+static int randomBelow(int bound)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (int) (randomState % (unsigned int) bound);
+}
+
+static void modelPut(Model* model, int key, int value)
+{
+    model->size += model->present[key] ? 0 : 1;
+    model->present[key] = true;
+    model->values[key] = value;
+}
+
+static void modelRemove(Model* model, int key)
+{
+    model->size -= model->present[key] ? 1 : 0;
+    model->present[key] = false;
+}
+
+// the smallest key from key on that is present, -1 if there is none
+static int nextPresent(const bool* present, int key)
+{
+    while(key < RANDOM_KEYS && !present[key])
+        key++;
+    return key < RANDOM_KEYS ? key : -1;
+}
+
+static int keyOrMissing(MapKeyElement key) { return key == NULL ? -1 : *(int*) key; }
+
+static bool checkAll(Map map, const bool* present, const int* values)
+{
+    int size = 0, expected = nextPresent(present, 0);
+    MAP_FOREACH_CURSOR(int*, key, cursor, map)
+    {
+        ASSERT_TEST(*key == expected);
+        ASSERT_TEST(*(int*) mapCursorGetData(&cursor) == values[expected]);
+        expected = nextPresent(present, expected + 1);
+        size++;
+    }
+    ASSERT_TEST(expected == -1);
+    ASSERT_TEST(mapGetSize(map) == size);
+    return true;
+}
+
+static bool checkLookup(Model* model, int key)
+{
+    ASSERT_TEST(mapContains(model->map, &key) == model->present[key]);
+    int* peeked = mapPeek(model->map, &key);
+    int* got = mapGet(model->map, &key);
+    ASSERT_TEST(model->present[key] ? peeked != NULL && *peeked == model->values[key] : peeked == NULL);
+    ASSERT_TEST(model->present[key] ? got != NULL && *got == model->values[key] : got == NULL);
+    return true;
+}
+
+static bool checkBounds(Model* model, int key)
+{
+    MapCursor cursor;
+    int expected = nextPresent(model->present, key);
+    ASSERT_TEST(keyOrMissing(mapLowerBound(model->map, &key, &cursor)) == expected);
+    for(int step = 0; step < 3 && expected != -1; step++)
+    {
+        expected = nextPresent(model->present, expected + 1);
+        ASSERT_TEST(keyOrMissing(mapCursorNext(&cursor)) == expected);
+    }
+    ASSERT_TEST(keyOrMissing(mapUpperBound(model->map, &key, NULL)) == nextPresent(model->present, key + 1));
+    return true;
+}
+
+static bool checkRange(Model* model, int from, int to)
+{
+    int expected = nextPresent(model->present, from);
+    MAP_FOREACH_RANGE(int*, key, cursor, model->map, &from, &to)
+    {
+        ASSERT_TEST(*key == expected && expected < to);
+        expected = nextPresent(model->present, expected + 1);
+    }
+    ASSERT_TEST(expected == -1 || expected >= to);
+    return true;
+}
+
+static bool randomPutOrRemove(Model* model, int key, bool grow)
+{
+    if(grow ? randomBelow(4) != 0 : randomBelow(4) == 0)
+    {
+        int value = randomBelow(RANDOM_KEYS);
+        ASSERT_TEST(mapPut(model->map, &key, &value) == MAP_SUCCESS);
+        modelPut(model, key, value);
+    }
+    else
+    {
+        ASSERT_TEST(mapRemove(model->map, &key) == (model->present[key] ? MAP_SUCCESS : MAP_ITEM_DOES_NOT_EXIST));
+        modelRemove(model, key);
+    }
+    return true;
+}
+
+static bool randomEntry(Model* model, int key)
+{
+    MapEntry entry;
+    int value = randomBelow(RANDOM_KEYS);
+    ASSERT_TEST(mapEntryFind(model->map, &key, &entry) == model->present[key]);
+    if(!model->present[key])
+    {
+        ASSERT_TEST(mapEntryInsert(&entry, &key, &value) == MAP_SUCCESS);
+        ASSERT_TEST(*(int*) mapEntryGet(&entry) == value);
+        modelPut(model, key, value);
+    }
+    else if(randomBelow(2) == 0)
+    {
+        ASSERT_TEST(*(int*) mapEntryGet(&entry) == model->values[key]);
+        ASSERT_TEST(mapEntrySet(&entry, &value) == MAP_SUCCESS);
+        modelPut(model, key, value);
+    }
+    else
+    {
+        ASSERT_TEST(mapEntryRemove(&entry) == MAP_SUCCESS);
+        ASSERT_TEST(mapEntryRemove(&entry) == MAP_ITEM_DOES_NOT_EXIST);
+        modelRemove(model, key);
+    }
+    return true;
+}
+
+static bool randomCursorRemove(Model* model, int key)
+{
+    MapCursor cursor;
+    int found = keyOrMissing(mapLowerBound(model->map, &key, &cursor));
+    ASSERT_TEST(found == nextPresent(model->present, key));
+    if(found == -1)
+        return true;
+    ASSERT_TEST(mapCursorRemove(&cursor) == MAP_SUCCESS);
+    ASSERT_TEST(mapCursorRemove(&cursor) == MAP_ITEM_DOES_NOT_EXIST);
+    modelRemove(model, found);
+    ASSERT_TEST(keyOrMissing(mapCursorNext(&cursor)) == nextPresent(model->present, found));
+    return true;
+}
+
+static bool randomGetOrPut(Model* model, int key)
+{
+    int value = randomBelow(RANDOM_KEYS);
+    int* got = mapGetOrPut(model->map, &key, &value);
+    if(!model->present[key])
+        modelPut(model, key, value);
+    ASSERT_TEST(got != NULL && *got == model->values[key]);
+    return true;
+}
+
+static bool randomBatch(Model* model)
+{
+    int size = 1 + randomBelow(RANDOM_BATCH);
+    int keys[RANDOM_BATCH], values[RANDOM_BATCH];
+    MapKeyElement keyElements[RANDOM_BATCH];
+    MapDataElement valueElements[RANDOM_BATCH];
+    // sorted batches without equal keys half of the time, any keys otherwise
+    bool sorted = randomBelow(2) == 0;
+    int key = randomBelow(RANDOM_KEYS / 2);
+    for(int i = 0; i < size; i++)
+    {
+        key = sorted ? key + 1 + randomBelow(3) : randomBelow(RANDOM_KEYS);
+        keys[i] = key;
+        values[i] = randomBelow(RANDOM_KEYS);
+        keyElements[i] = &keys[i];
+        valueElements[i] = &values[i];
+    }
+    ASSERT_TEST(mapPutBatch(model->map, keyElements, valueElements, size) == MAP_SUCCESS);
+    for(int i = 0; i < size; i++)
+        modelPut(model, keys[i], values[i]);
+    return true;
+}
+
+static bool randomCopy(Model* model)
+{
+    Model* copy = &models[RANDOM_COPY_MODEL];
+    mapDestroy(copy->map);
+    copy->map = mapCopy(model->map);
+    ASSERT_TEST(copy->map != NULL);
+    memcpy(copy->values, model->values, sizeof(copy->values));
+    memcpy(copy->present, model->present, sizeof(copy->present));
+    copy->size = model->size;
+    return true;
+}
+
+static bool randomFreeze(Model* model)
+{
+    ASSERT_TEST(mapFreeze(model->map) == MAP_SUCCESS);
+    ASSERT_TEST(mapIsFrozen(model->map));
+    for(int i = 0; i < 8; i++)
+    {
+        int key = randomBelow(RANDOM_KEYS);
+        ASSERT_TEST(mapContains(model->map, &key) == model->present[key]);
+    }
+    return true;
+}
+
+// the maps built from whole maps: from sorted pairs, and the merge, intersection and difference of two maps
+static bool checkBuiltMaps(Model* first, Model* second)
+{
+    static int keys[RANDOM_KEYS];
+    static MapKeyElement keyElements[RANDOM_KEYS];
+    static MapDataElement valueElements[RANDOM_KEYS];
+    static bool present[RANDOM_KEYS];
+    static int values[RANDOM_KEYS];
+    int size = 0;
+    for(int key = nextPresent(first->present, 0); key != -1; key = nextPresent(first->present, key + 1))
+    {
+        keys[size] = key;
+        keyElements[size] = &keys[size];
+        valueElements[size] = &first->values[key];
+        size++;
+    }
+    Map built = mapCreateFromSorted(copyInt, copyInt, freeInt, freeInt, compareInts, keyElements, valueElements, size);
+    ASSERT_TEST(built != NULL && checkAll(built, first->present, first->values));
+    mapDestroy(built);
+
+    for(int key = 0; key < RANDOM_KEYS; key++)
+    {
+        present[key] = first->present[key] || second->present[key];
+        values[key] = second->present[key] ? second->values[key] : first->values[key];
+    }
+    built = mapMerge(first->map, second->map);
+    ASSERT_TEST(built != NULL && checkAll(built, present, values));
+    mapDestroy(built);
+
+    for(int key = 0; key < RANDOM_KEYS; key++)
+        present[key] = first->present[key] && second->present[key];
+    built = mapIntersect(first->map, second->map);
+    ASSERT_TEST(built != NULL && checkAll(built, present, first->values));
+    mapDestroy(built);
+
+    for(int key = 0; key < RANDOM_KEYS; key++)
+        present[key] = first->present[key] && !second->present[key];
+    built = mapDifference(first->map, second->map);
+    ASSERT_TEST(built != NULL && checkAll(built, present, first->values));
+    mapDestroy(built);
+    return true;
+}
+
+static bool randomOperation(Model* model, bool grow)
+{
+    int key = randomBelow(RANDOM_KEYS);
+    int kind = randomBelow(100);
+    if(kind < 40)       return randomPutOrRemove(model, key, grow);
+    else if(kind < 50)  return randomEntry(model, key);
+    else if(kind < 55)  return randomCursorRemove(model, key);
+    else if(kind < 60)  return randomGetOrPut(model, key);
+    else if(kind < 75)  return checkLookup(model, key);
+    else if(kind < 85)  return checkBounds(model, key);
+    else if(kind < 90)  return checkRange(model, key, key + randomBelow(RANDOM_RANGE));
+    else if(kind < 92)  return randomBatch(model);
+    else if(kind < 93)  return randomCopy(&models[randomBelow(RANDOM_COPY_MODEL)]);
+    else if(kind < 94)  return randomFreeze(model);
+    return checkLookup(model, key);
+}
+
+// the maps, a plain one, a hashed one and a copy of either, are compared with plain arrays after every operation
+static bool testRandomOperations()
+{
+    for(int i = 0; i < RANDOM_MODELS; i++)
+    {
+        models[i].map = createIntMap(i == 1);
+        ASSERT_TEST(models[i].map != NULL);
+    }
+    ASSERT_TEST(mapSetStatsEnabled(models[0].map, true) == MAP_SUCCESS);
+    int peakSize = 0;
+
+    for(int operation = 1; operation <= RANDOM_OPERATIONS; operation++)
+    {
+        Model* model = &models[randomBelow(RANDOM_MODELS)];
+        ASSERT_TEST(randomOperation(model, operation / RANDOM_PHASE % 2 == 0));
+        ASSERT_TEST(mapGetSize(model->map) == model->size);
+        peakSize = models[0].size > peakSize ? models[0].size : peakSize;
+        if(operation % RANDOM_CHECK_EVERY != 0)
+            continue;
+        for(int i = 0; i < RANDOM_MODELS; i++)
+            ASSERT_TEST(checkAll(models[i].map, models[i].present, models[i].values));
+        ASSERT_TEST(checkBuiltMaps(&models[0], &models[1]));
+        ASSERT_TEST(checkBuiltMaps(&models[RANDOM_COPY_MODEL], &models[0]));
+    }
+
+    MapStats stats;
+    ASSERT_TEST(mapGetStats(models[0].map, &stats) == MAP_SUCCESS);
+    ASSERT_TEST(stats.peakSize == peakSize && stats.searches > 0 && stats.allocations > 0);
+    ASSERT_TEST(mapGetStats(models[1].map, &stats) == MAP_ERROR);
+    for(int i = 0; i < RANDOM_MODELS; i++)
+        mapDestroy(models[i].map);
+    return true;
+}
+
+int main()
+{
+    int failed = 0;
+    RUN_TEST(testGetManyEmptyHashed, "testGetManyEmptyHashed", failed);
+    RUN_TEST(testGetMany, "testGetMany", failed);
+    RUN_TEST(testSeparateMapsOnThreads, "testSeparateMapsOnThreads", failed);
+    RUN_TEST(testParallelForEachOnSharedMaps, "testParallelForEachOnSharedMaps", failed);
+    RUN_TEST(testRandomOperations, "testRandomOperations", failed);
+    return failed == 0 ? 0 : 1;
+}
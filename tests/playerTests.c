@@ -0,0 +1,57 @@
+#include <stdbool.h>
+#include "test_utilities.h"
+#include "../includes/Player.h"
+
+#define MANY_TOURNAMENTS 20
+
+static bool testAddTournamentGame()
+{
+    Player player = PlayerCreate(1);
+    ASSERT_TEST(player != NULL);
+    for(int round = 1; round <= 3; round++)
+    {
+        for(int id = MANY_TOURNAMENTS; id > 0; id--)
+            ASSERT_TEST(PlayerAddTournamentGame(player, id));
+    }
+    ASSERT_TEST(PlayerGetNumOfTournaments(player) == MANY_TOURNAMENTS);
+    for(int i = 0; i < MANY_TOURNAMENTS; i++)
+    {
+        ASSERT_TEST(PlayerGetTournamentID(player, i) == i + 1);
+        ASSERT_TEST(PlayerGetTournamentGames(player, i + 1) == 3);
+    }
+    ASSERT_TEST(PlayerRemoveTournament(player, 5));
+    ASSERT_TEST(!PlayerRemoveTournament(player, 5));
+    ASSERT_TEST(PlayerGetTournamentGames(player, 5) == 0);
+    ASSERT_TEST(PlayerGetNumOfTournaments(player) == MANY_TOURNAMENTS - 1);
+    PlayerDestroy(player);
+    return true;
+}
+
+static bool testCopyManyTournaments()
+{
+    for(int count = 0; count <= MANY_TOURNAMENTS; count++)
+    {
+        Player player = PlayerCreate(1);
+        ASSERT_TEST(player != NULL);
+        for(int id = 1; id <= count; id++)
+            ASSERT_TEST(PlayerAddTournamentGame(player, id));
+        Player copy = PlayerCopy(player);
+        ASSERT_TEST(copy != NULL);
+        PlayerDestroy(player);
+        ASSERT_TEST(PlayerGetNumOfTournaments(copy) == count);
+        for(int id = 1; id <= count; id++)
+            ASSERT_TEST(PlayerGetTournamentGames(copy, id) == 1);
+        ASSERT_TEST(PlayerAddTournamentGame(copy, count + 1));
+        ASSERT_TEST(PlayerGetNumOfTournaments(copy) == count + 1);
+        PlayerDestroy(copy);
+    }
+    return true;
+}
+
+int main()
+{
+    int failed = 0;
+    RUN_TEST(testAddTournamentGame, "testAddTournamentGame", failed);
+    RUN_TEST(testCopyManyTournaments, "testCopyManyTournaments", failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+/**
+ * Counts the mallocs per operation of a map of int keys and values: BENCHMARK_KEYS keys are inserted,
+ * then each is removed and put back, and last as many small maps are built and destroyed one after the other,
+ * which empties the pools again and again. malloc and calloc are wrapped by the linker to be counted:
+ *
+ *   make pool_benchmark && ./pool_benchmark
+ *
+ * The program uses only mapCreate, mapPut, mapRemove and mapDestroy with copyIntKey and freeIntKey,
+ * so it also builds against the tree from before the pools (git checkout 122157a^ -- lib utilities.c),
+ * which gives the "B-tree, malloc" numbers to compare with.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../lib/Map.h"
+#include "../utilities.h"
+
+#define BENCHMARK_KEYS 100000
+#define SMALL_MAP_KEYS 4
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+
+static long allocations = 0;
+
+void* __wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+static void report(const char* phase, long before, clock_t start)
+{
+    printf("%-12s %.3f mallocs/op  %.1f ns/op\n", phase, (double) (allocations - before) / BENCHMARK_KEYS,
+           (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / BENCHMARK_KEYS);
+}
+
+int main()
+{
+    Map map = mapCreate(copyIntKey, copyIntKey, freeIntKey, freeIntKey, compareIntKey);
+    if(map == NULL)
+        return 1;
+
+    long before = allocations;
+    clock_t start = clock();
+    for(int i = 0; i < BENCHMARK_KEYS; i++)
+    {
+        int key = (int) ((i * 2654435761u) % BENCHMARK_KEYS);
+        mapPut(map, &key, &key);
+    }
+    report("insert", before, start);
+
+    before = allocations;
+    start = clock();
+    for(int i = 0; i < BENCHMARK_KEYS; i++)
+    {
+        mapRemove(map, &i);
+        mapPut(map, &i, &i);
+    }
+    report("remove+put", before, start);
+    mapDestroy(map);
+
+    before = allocations;
+    start = clock();
+    for(int i = 0; i < BENCHMARK_KEYS; i++)
+    {
+        Map small = mapCreate(copyIntKey, copyIntKey, freeIntKey, freeIntKey, compareIntKey);
+        for(int key = 0; key < SMALL_MAP_KEYS; key++)
+            mapPut(small, &key, &key);
+        mapDestroy(small);
+    }
+    report("small maps", before, start);
+    return 0;
+}
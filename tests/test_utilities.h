@@ -0,0 +1,31 @@
+#ifndef TEST_UTILITIES_H_
+#define TEST_UTILITIES_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Evaluates b and continues if b is true.
+ * If b is false, ends the test by returning false and prints a detailed
+ * message about the failure.
+ */
+#define ASSERT_TEST(b) do { \
+        if (!(b)) { \
+                printf("\nAssertion failed at %s:%d %s ",__FILE__,__LINE__,#b); \
+                return false; \
+        } \
+} while (0)
+
+/**
+ * Macro used for running a test from the main function, failed counts the failed tests
+ */
+#define RUN_TEST(test, name, failed) do { \
+        if (test()) { \
+                printf("[OK] %s\n", name); \
+        } else { \
+                printf("[Failed] %s\n", name); \
+                (failed)++; \
+        } \
+} while (0)
+
+#endif /* TEST_UTILITIES_H_ */
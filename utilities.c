@@ -6,23 +6,33 @@
 #include <assert.h>
 
 #include "utilities.h"
+#include "lib/Pool.h"
+
+#define INT_KEYS_PER_SLAB 256
+
+// int keys and values are the most common map elements, they share one pool instead of a malloc each
+static Pool intPool = POOL_INITIALIZER(int, INT_KEYS_PER_SLAB);
 
 VoidPtr copyIntKey(VoidPtr key) {
    if (!key) return NULL;
-    int* newKey = malloc(sizeof(*newKey));
+    int* newKey = poolAlloc(&intPool);
     if (!newKey) return NULL;
     *newKey = *(int*)key;
     return newKey;
 }
 
 void freeIntKey(VoidPtr id) {
-    free( (int*) id) ;
+    poolFree(&intPool, id);
 }
 
 int compareIntKey(VoidPtr id1, VoidPtr id2) {
     return (*(int*) id1 - *(int*)id2);
 }
 
+unsigned int hashIntKey(VoidPtr id) {
+    return (unsigned int) *(int*) id;
+}
+
 VoidPtr copyDoubleData(VoidPtr key) {
     if (!key) return NULL;
     int* newKey = malloc(sizeof(*newKey));
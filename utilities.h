@@ -12,6 +12,7 @@ typedef void* VoidPtr;
 VoidPtr copyIntKey(VoidPtr key);
 void freeIntKey(VoidPtr id);
 int compareIntKey(VoidPtr id1, VoidPtr id2);
+unsigned int hashIntKey(VoidPtr id);
 
 VoidPtr copyDoubleData(VoidPtr key);
 void freeDoubleData(VoidPtr id);